@@ -38,8 +38,8 @@ void prestart_loop() {
   // - It is invoked when ZWAppliance is NOT in service mode
   //   * Current mode varies, can be one of APP_STARTUP, APP_INIT, APP_PORTAL
   // - Invocation interval varies, depending on appliance mode and states
-  //   * When stable in APP_PORTAL mode, interval tend to match normal loop()
-  //   * Otherwise, expect random interval up to ~100ms
+  //   * The appliance idles between events (WiFi, timers, web requests)
+  //   * Expect random interval up to ~1s
 
 	Serial.println("Service Pre-start Loopt!");
 	delay(100);
@@ -53,6 +53,9 @@ bool startup() {
   // - WebPortal: Started if idle timeout configured (default 5min)
   // If return is false, appliance enters service bypass mode, and would
   //   not call startup/loop/teardown anymore (until next restart)
+  // Periodic work can be registered here with Appliance_Schedule_*(),
+  //   scheduled tasks are dispatched before each loop() invocation,
+  //   and are cancelled automatically after teardown()
 
 	Serial.println("Service Startup!");
 	return true;
@@ -0,0 +1,54 @@
+// This demo requires a modified ESP8266 Arduino, found here:
+// https://github.com/Adam5Wu/Arduino
+// This demo requires the following libraries:
+// https://github.com/Adam5Wu/ZWUtils-Arduino
+// https://github.com/Adam5Wu/ESPVFATFS
+// https://github.com/Adam5Wu/ArduinoJson
+// https://github.com/Adam5Wu/Time
+// https://github.com/Adam5Wu/Timezone
+// https://github.com/Adam5Wu/ESPEasyAuth
+// https://github.com/Adam5Wu/ESPAsyncTCP
+// https://github.com/me-no-dev/ESPAsyncUDP
+// https://github.com/Adam5Wu/ESPAsyncWebServer
+
+// This demo measures the latency of RTC memory writes versus slot count
+// Note: it overwrites the user portion of the RTC memory
+#define NO_GLOBAL_SPIFFS
+
+#include <ESPZWAppliance.h>
+
+#define BENCH_ROUNDS 100
+
+void setup() {
+  // This function is NOT the actual sketch setup.
+  // (The sketch setup has been managed by the ZWAppliance)
+  // This function is invoked once at the end of ZWAppliance setup.
+
+	uint8_t Available = Appliance_RTCMemory_Available();
+	uint32_t Buffer[Available];
+	Serial.printf("RTC memory write benchmark (%d user slots)\n", Available);
+
+	for (uint8_t Count = 1; Count <= Available; Count <<= 1) {
+		uint32_t TotalUS = 0;
+		uint32_t MaxUS = 0;
+		for (int Round = 0; Round < BENCH_ROUNDS; Round++) {
+			// Always change the content, unchanged writes are skipped
+			for (uint8_t i = 0; i < Count; i++) Buffer[i] = Round ^ i;
+			uint32_t StartUS = micros();
+			Appliance_RTCMemory_Write(0, Buffer, Count);
+			uint32_t SpanUS = micros() - StartUS;
+			TotalUS += SpanUS;
+			if (SpanUS > MaxUS) MaxUS = SpanUS;
+		}
+		Serial.printf("%3d slot(s): avg %u us, max %u us\n",
+			Count, TotalUS / BENCH_ROUNDS, MaxUS);
+		yield();
+	}
+}
+
+void loop() {
+  // This function is NOT the actual sketch loop.
+  // (The sketch loop has been managed by the ZWAppliance)
+
+	delay(1000);
+}
@@ -7,9 +7,11 @@
 
 #include "AppBaseUtils.hpp"
 
-AsyncAPIConfigWebHandler::AsyncAPIConfigWebHandler(String const &path, Dir const& dir)
+AsyncAPIConfigWebHandler::AsyncAPIConfigWebHandler(String const &path, Dir const& dir,
+	ConfigSyncCallback const &onSync)
 	: _dir(dir)
 	, Path(AsyncPathURIWebHandler::normalizePath(path))
+	, OnSync(onSync)
 {
 	_onGETPathNotFound = std::bind(&AsyncAPIConfigWebHandler::_pathNotFound, this, std::placeholders::_1);
 }
@@ -57,6 +59,7 @@ void AsyncAPIConfigWebHandler::_handleRequest(AsyncWebRequest &request) {
 		return;
 	}
 
+	if (OnSync) OnSync(subpath, false);
 	switch (JsonManagerResults JMRet = JsonManager(_dir, subpath, false,
 		[&](JsonObject & obj, BoundedDynamicJsonBuffer & buf) {
 		switch (request.queries()) {
@@ -170,11 +173,15 @@ void AsyncAPIConfigWebHandler::_handleRequest(AsyncWebRequest &request) {
 
 	case JSONMAN_OK_UPDATED:
 		// Update operation successful
+		if (OnSync) OnSync(subpath, true);
 		request.send(204);
 		break;
 
-	case JSONMAN_WARN_NOSTOR:
 	case JSONMAN_WARN_UPDATEFAIL:
+		// File may be partially written
+		if (OnSync) OnSync(subpath, true);
+		// Fall through
+	case JSONMAN_WARN_NOSTOR:
 		request.send_P(500, PSTR("Unable to update target file"), F("text/plain"));
 		break;
 
@@ -40,6 +40,9 @@
 #define ESPWSCFG_DEBUGVV(...) ESPWSCFG_LOG(__VA_ARGS__)
 #endif
 
+// Called before a file is accessed (updated = false) and after it is modified
+typedef std::function<void(String const &name, bool updated)> ConfigSyncCallback;
+
 class AsyncAPIConfigWebHandler: public AsyncWebHandler {
   protected:
     Dir _dir;
@@ -48,9 +51,11 @@ class AsyncAPIConfigWebHandler: public AsyncWebHandler {
 
   public:
     String const Path;
+    ConfigSyncCallback const OnSync;
     ArRequestHandlerFunction _onGETPathNotFound;
 
-    AsyncAPIConfigWebHandler(String const &path, Dir const& dir);
+    AsyncAPIConfigWebHandler(String const &path, Dir const& dir,
+                             ConfigSyncCallback const &onSync = nullptr);
 
     virtual bool _canHandle(AsyncWebRequest const &request) override;
     virtual bool _checkContinue(AsyncWebRequest &request, bool continueHeader) override;
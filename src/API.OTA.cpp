@@ -6,8 +6,9 @@
 
 #include "AppBaseUtils.hpp"
 
-AsyncAPIOTAWebHandler::AsyncAPIOTAWebHandler(String const &path, String const &uiurl)
-  : Path(path), UIUrl(uiurl)
+AsyncAPIOTAWebHandler::AsyncAPIOTAWebHandler(String const &path, String const &uiurl,
+                                             OTAEventCallback const &onEvent)
+  : Path(path), UIUrl(uiurl), OnEvent(onEvent)
 {
   // Do Nothing
 }
@@ -67,6 +68,7 @@ bool AsyncAPIOTAWebHandler::_checkContinue(AsyncWebRequest &request, bool contin
     request.send(500, std::move(UpdateErr), F("text/plain"));
     return false;
   }
+  if (OnEvent) OnEvent(OTA_BEGIN);
   return AsyncWebHandler::_checkContinue(request, continueHeader);
 }
 
@@ -76,6 +78,7 @@ void AsyncAPIOTAWebHandler::_terminateRequest(AsyncWebRequest &request) {
       ESPWSOTA_DEBUG("[%s] WARNING: Aborting unsuccessful update...\n",
                      request._remoteIdent.c_str());
       Update.end();
+      if (OnEvent) OnEvent(OTA_FAILED);
     }
     _updateFile.clear(true);
     _updateReq = nullptr;
@@ -157,6 +160,7 @@ void AsyncAPIOTAWebHandler::_handleRequest(AsyncWebRequest &request) {
   if (Update.end()) {
     ESPWSOTA_DEBUG("[%s] Successfully applied update '%s'!\n",
                    request._remoteIdent.c_str(), _updateFile.c_str());
+    if (OnEvent) OnEvent(OTA_APPLIED);
     request.send(204);
     return;
   }
@@ -165,6 +169,7 @@ void AsyncAPIOTAWebHandler::_handleRequest(AsyncWebRequest &request) {
     Update.printError(UpdateErr);
     UpdateErr.trim();
     ESPWSOTA_DEBUG("[%s] %s\n", request._remoteIdent.c_str(), UpdateErr.c_str());
+    if (OnEvent) OnEvent(OTA_FAILED);
     request.send(500, std::move(UpdateErr), F("text/plain"));
   }
 }
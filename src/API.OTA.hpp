@@ -40,6 +40,14 @@
 #define ESPWSOTA_DEBUGVV(...) ESPWSOTA_LOG(__VA_ARGS__)
 #endif
 
+typedef enum {
+  OTA_BEGIN = 0,
+  OTA_APPLIED,
+  OTA_FAILED,
+} OTAEvent;
+
+typedef std::function<void(OTAEvent event)> OTAEventCallback;
+
 class AsyncAPIOTAWebHandler: public AsyncWebHandler {
   protected:
     String _updateFile;
@@ -49,7 +57,9 @@ class AsyncAPIOTAWebHandler: public AsyncWebHandler {
   public:
     String const Path;
     String const UIUrl;
-    AsyncAPIOTAWebHandler(String const &path, String const &uiurl);
+    OTAEventCallback const OnEvent;
+    AsyncAPIOTAWebHandler(String const &path, String const &uiurl,
+                          OTAEventCallback const &onEvent = nullptr);
 
     virtual bool _canHandle(AsyncWebRequest const &request) override;
     virtual bool _checkContinue(AsyncWebRequest &request, bool continueHeader) override;
@@ -1,38 +1,129 @@
 
 #include "AppBaseUtils.hpp"
 
+#include <ctype.h>
+
+#include <MD5Builder.h>
+#include <bearssl/bearssl_hmac.h>
+
 #include <Units.h>
 
+JsonWriteStats JsonManagerStats;
+
+// A temporary file next to the original means the replacement did not complete:
+// it is still being written if the original exists, otherwise it is complete
+static void JsonRecoverFile(fs::Dir &dir, String const &name, String const &temp) {
+  if (!dir.exists(temp)) return;
+  if (dir.exists(name)) {
+    ESPAPP_DEBUG("WARNING: Discarding incomplete update of json file '%s'\n", name.c_str());
+    dir.remove(temp);
+  } else {
+    ESPAPP_DEBUG("WARNING: Completing interrupted update of json file '%s'\n", name.c_str());
+    if (dir.rename(temp, name)) JsonManagerStats.Recovered++;
+  }
+}
+
+static bool JsonReplaceFile(fs::Dir &dir, String const &name, String const &temp) {
+  if (dir.exists(name) && !dir.remove(name)) {
+    ESPAPP_DEBUG("WARNING: Unable to replace json file '%s'\n", name.c_str());
+    dir.remove(temp);
+    JsonManagerStats.Failed++;
+    return false;
+  }
+  if (!dir.rename(temp, name)) {
+    // Leave the complete temporary file for recovery
+    ESPAPP_DEBUG("WARNING: Unable to rename temporary json file '%s'\n", temp.c_str());
+    JsonManagerStats.Failed++;
+    return false;
+  }
+  JsonManagerStats.Written++;
+  return true;
+}
+
+static bool JsonSameContent(fs::File &file, String const &data) {
+  if (file.size() != data.length()) return false;
+  if (!file.seek(0, SeekSet)) return false;
+  uint8_t Buffer[JSON_STREAM_CHUNK];
+  size_t bufofs = 0;
+  while (bufofs < data.length()) {
+    int Len = file.read(Buffer, std::min<size_t>(sizeof(Buffer), data.length() - bufofs));
+    if (Len <= 0) return false;
+    if (memcmp(Buffer, data.c_str() + bufofs, Len)) return false;
+    bufofs += Len;
+  }
+  return true;
+}
+
+bool JsonSaveFile(fs::Dir &dir, String const &name, String const &data) {
+  String TempName = name + F(JSON_STREAM_TEMP_EXT);
+  JsonRecoverFile(dir, name, TempName);
+  {
+    fs::File Current = dir.openFile(name, "r");
+    if (Current && JsonSameContent(Current, data)) {
+      ESPAPP_DEBUGV("Json file '%s' unchanged, write skipped\n", name.c_str());
+      JsonManagerStats.Unchanged++;
+      return true;
+    }
+  }
+
+  fs::File TempFile = dir.openFile(TempName, "w");
+  if (!TempFile) {
+    ESPAPP_DEBUG("WARNING: Unable to create temporary file '%s'\n", TempName.c_str());
+    JsonManagerStats.Failed++;
+    return false;
+  }
+  size_t bufofs = 0;
+  while (data.length() > bufofs) {
+    size_t outlen = TempFile.write(((uint8_t*)data.begin()) + bufofs, data.length() - bufofs);
+    if (!outlen) {
+      ESPAPP_DEBUG("WARNING: failed to write json file '%s'\n", name.c_str());
+      TempFile.close();
+      dir.remove(TempName);
+      JsonManagerStats.Failed++;
+      return false;
+    }
+    bufofs += outlen;
+  }
+  TempFile.close();
+  if (!JsonReplaceFile(dir, name, TempName)) return false;
+  ESPAPP_DEBUGV("Json data written to '%s' (%s)\n", name.c_str(),
+                ToString(bufofs, SizeUnit::BYTE, true).c_str());
+  return true;
+}
+
 JsonManagerResults JsonManager(fs::Dir &dir, String const &name,
                                bool create_new_if_dne,
                                JsonObjectCallback const &obj_cb,
                                JsonFileCallback const &malstor_cb,
                                uint8_t nest_limit, size_t buf_limit) {
   JsonManagerResults Ret = JSONMAN_ERR_MALSTOR;
+  JsonRecoverFile(dir, name, name + F(JSON_STREAM_TEMP_EXT));
   fs::File JsonFile = dir.openFile(name, "r+");
   BoundedOneshotAllocator BoundedAllocator(buf_limit);
   String UpdateData;
-  if (JsonFile && JsonFile.size()) {
-    while (true) {
-      {
-        BoundedDynamicJsonBuffer jsonBuffer(BoundedAllocator, buf_limit-BoundedDynamicJsonBuffer::EmptyBlockSize);
-        JsonObject& JsonObj = jsonBuffer.parseObject(JsonFile, nest_limit);
-        if (JsonObj.success()) {
-          if (obj_cb(JsonObj, jsonBuffer)) {
-            JsonObj.prettyPrintTo(UpdateData);
-            Ret = JSONMAN_OK_UPDATED;
-          } else {
-            Ret = JSONMAN_OK_READONLY;
-          }
-          break;
+  bool Loaded = false;
+  while (JsonFile && JsonFile.size()) {
+    {
+      BoundedDynamicJsonBuffer jsonBuffer(BoundedAllocator, buf_limit-BoundedDynamicJsonBuffer::EmptyBlockSize);
+      JsonObject& JsonObj = jsonBuffer.parseObject(JsonFile, nest_limit);
+      if (JsonObj.success()) {
+        if (obj_cb(JsonObj, jsonBuffer)) {
+          JsonObj.prettyPrintTo(UpdateData);
+          Ret = JSONMAN_OK_UPDATED;
+        } else {
+          Ret = JSONMAN_OK_READONLY;
         }
+        Loaded = true;
+        break;
       }
-
-      ESPAPP_DEBUG("WARNING: error loading json file '%s'\n", name.c_str());
-      if (malstor_cb && malstor_cb(JsonFile)) continue;
-      break;
     }
-  } else {
+
+    ESPAPP_DEBUG("WARNING: error loading json file '%s'\n", name.c_str());
+    // Retry if the callback has repaired the storage, an emptied file is handled as new
+    if (!malstor_cb || !malstor_cb(JsonFile)) return Ret;
+    JsonFile.seek(0, SeekSet);
+  }
+  if (!Loaded) {
     if (!JsonFile) {
       ESPAPP_DEBUGV("WARNING: Unable to open json file '%s'\n", name.c_str());
       if (create_new_if_dne) {
@@ -63,25 +154,435 @@ JsonManagerResults JsonManager(fs::Dir &dir, String const &name,
     }
   }
   if (Ret == JSONMAN_OK_UPDATED) {
-    if (!JsonFile.truncate(0)) {
-      ESPAPP_DEBUG("WARNING: unable to truncate json file '%s'\n", name.c_str());
+    JsonFile.close();
+    if (!JsonSaveFile(dir, name, UpdateData))
       Ret = JSONMAN_WARN_UPDATEFAIL;
-    } else {
-      size_t bufofs = 0;
-      while (UpdateData.length() > bufofs) {
-        size_t outlen = JsonFile.write(((uint8_t*)UpdateData.begin()) + bufofs, UpdateData.length() - bufofs);
-        if (outlen < 0) {
-          ESPAPP_DEBUG("WARNING: failed to write json file '%s'\n", name.c_str());
-          Ret = JSONMAN_WARN_UPDATEFAIL;
+  }
+  return Ret;
+}
+
+// Buffered character source, tracking the consumed offset
+class JsonStreamReader {
+  protected:
+    fs::File &_file;
+    uint8_t _buf[JSON_STREAM_CHUNK];
+    size_t _len;
+    size_t _pos;
+    size_t _offset;
+
+  public:
+    JsonStreamReader(fs::File &file) : _file(file), _len(0), _pos(0), _offset(0) {}
+
+    int peek() {
+      if (_pos == _len) {
+        int Len = _file.read(_buf, sizeof(_buf));
+        if (Len <= 0) return -1;
+        _len = Len;
+        _pos = 0;
+      }
+      return _buf[_pos];
+    }
+
+    int next() {
+      int c = peek();
+      if (c >= 0) {
+        _pos++;
+        _offset++;
+      }
+      return c;
+    }
+
+    int skipSpace() {
+      int c;
+      while ((c = peek()) >= 0 && isspace(c)) next();
+      return c;
+    }
+
+    size_t offset() const { return _offset; }
+};
+
+// Scalar literal: true, false, null or a number
+static bool JsonStreamLiteral(char const *lit) {
+  if (!strcmp(lit, "true") || !strcmp(lit, "false") || !strcmp(lit, "null")) return true;
+  char const *p = lit;
+  if (*p == '-') p++;
+  if (!isdigit(*p)) return false;
+  while (isdigit(*p)) p++;
+  if (*p == '.') {
+    if (!isdigit(*++p)) return false;
+    while (isdigit(*p)) p++;
+  }
+  if (*p == 'e' || *p == 'E') {
+    p++;
+    if (*p == '+' || *p == '-') p++;
+    if (!isdigit(*p)) return false;
+    while (isdigit(*p)) p++;
+  }
+  return !*p;
+}
+
+typedef enum {
+  JSONSCAN_VALUE,
+  JSONSCAN_VALUE_OR_END,
+  JSONSCAN_KEY,
+  JSONSCAN_KEY_OR_END,
+  JSONSCAN_COLON,
+  JSONSCAN_SEPARATOR,
+} JsonScanState;
+
+// Consume one json value, validating its grammar and passing its characters to the sink
+static bool JsonStreamScan(JsonStreamReader &reader, std::function<void(char)> const &sink) {
+  uint32_t Nesting = 0; // One bit per level, set for objects
+  uint8_t Depth = 0;
+  JsonScanState State = JSONSCAN_VALUE;
+  bool InString = false, Escape = false, IsKey = false;
+  char Literal[JSON_STREAM_LITERAL + 1];
+  uint8_t LiteralLen = 0;
+  while (true) {
+    int c = reader.peek();
+    if (InString) {
+      if (c < 0 || ((c < 0x20) && !Escape)) return false;
+      reader.next();
+      if (sink) sink(c);
+      if (Escape) Escape = false;
+      else if (c == '\\') Escape = true;
+      else if (c == '"') {
+        InString = false;
+        State = IsKey? JSONSCAN_COLON : JSONSCAN_SEPARATOR;
+        if (!Depth) return true;
+      }
+      continue;
+    }
+    if (LiteralLen) {
+      if (c >= 0 && (isalnum(c) || c == '+' || c == '-' || c == '.')) {
+        if (LiteralLen >= JSON_STREAM_LITERAL) return false;
+        Literal[LiteralLen++] = c;
+        reader.next();
+        if (sink) sink(c);
+        continue;
+      }
+      Literal[LiteralLen] = '\0';
+      LiteralLen = 0;
+      if (!JsonStreamLiteral(Literal)) return false;
+      State = JSONSCAN_SEPARATOR;
+      if (!Depth) return true;
+    }
+    if (c < 0) return false;
+    if (isspace(c)) {
+      if (!Depth) return false;
+      reader.next();
+      if (sink) sink(c);
+      continue;
+    }
+
+    bool Close = false;
+    switch (State) {
+      case JSONSCAN_KEY_OR_END:
+        if (c == '}') {
+          Close = true;
+          break;
+        }
+        // Fall through
+      case JSONSCAN_KEY:
+        if (c != '"') return false;
+        InString = IsKey = true;
+        break;
+
+      case JSONSCAN_COLON:
+        if (c != ':') return false;
+        State = JSONSCAN_VALUE;
+        break;
+
+      case JSONSCAN_VALUE_OR_END:
+        if (c == ']') {
+          Close = true;
           break;
         }
-        bufofs += outlen;
+        // Fall through
+      case JSONSCAN_VALUE:
+        if (c == '{' || c == '[') {
+          if (Depth >= 32) return false;
+          Nesting = (Nesting << 1) | (c == '{');
+          Depth++;
+          State = (c == '{')? JSONSCAN_KEY_OR_END : JSONSCAN_VALUE_OR_END;
+        } else if (c == '"') {
+          InString = true;
+          IsKey = false;
+        } else if (c == '-' || isalnum(c)) {
+          Literal[LiteralLen++] = c;
+        } else return false;
+        break;
+
+      case JSONSCAN_SEPARATOR:
+        if (c == ',') {
+          State = (Nesting & 1)? JSONSCAN_KEY : JSONSCAN_VALUE;
+        } else if (c == ((Nesting & 1)? '}' : ']')) {
+          Close = true;
+        } else return false;
+        break;
+    }
+    reader.next();
+    if (sink) sink(c);
+    if (Close) {
+      Nesting >>= 1;
+      State = JSONSCAN_SEPARATOR;
+      if (!--Depth) return true;
+    }
+  }
+}
+
+// Read a member key, only the first JSON_MAXIMUM_STREAM_KEY characters are kept
+static bool JsonStreamKey(JsonStreamReader &reader, String &key, bool &truncated) {
+  if (reader.next() != '"') return false;
+  bool Escape = false;
+  truncated = false;
+  while (true) {
+    int c = reader.next();
+    if (c < 0 || ((c < 0x20) && !Escape)) return false;
+    if (!Escape && c == '"') return true;
+    Escape = !Escape && (c == '\\');
+    if (key.length() < JSON_MAXIMUM_STREAM_KEY) key.concat((char)c);
+    else truncated = true;
+  }
+}
+
+bool JsonStreamCheck(fs::File &file) {
+  if (!file.seek(0, SeekSet)) return false;
+  JsonStreamReader Reader(file);
+  if (Reader.skipSpace() != '{') return false;
+  if (!JsonStreamScan(Reader, nullptr)) return false;
+  return Reader.skipSpace() < 0;
+}
+
+JsonManagerResults JsonStreamManager(fs::Dir &dir, String const &name,
+                                     bool create_new_if_dne,
+                                     JsonMemberCallback const &member_cb,
+                                     JsonAppendCallback const &append_cb,
+                                     size_t value_limit) {
+  String TempName = name + F(JSON_STREAM_TEMP_EXT);
+  JsonRecoverFile(dir, name, TempName);
+  fs::File JsonFile = dir.openFile(name, "r");
+  bool Exists = (bool)JsonFile;
+  if (!Exists) {
+    ESPAPP_DEBUGV("WARNING: Unable to open json file '%s'\n", name.c_str());
+    if (!create_new_if_dne) return JSONMAN_WARN_NOSTOR;
+  }
+  bool Empty = !Exists || !JsonFile.size();
+
+  // Output is only started on the first modification, by copying the unmodified
+  // content read so far; members after that are re-serialized one per line
+  fs::File Output;
+  size_t KeptEnd = 0;
+  uint16_t Members = 0;
+  bool WriteFail = false;
+
+  auto Put = [&](String const &data) {
+    if (Output.write((uint8_t const*)data.c_str(), data.length()) != data.length())
+      WriteFail = true;
+  };
+  // Copy a range of the original file, without disturbing the reading position
+  auto CopyRaw = [&](size_t start, size_t end) {
+    size_t Position = JsonFile.position();
+    JsonFile.seek(start, SeekSet);
+    uint8_t Buffer[JSON_STREAM_CHUNK];
+    size_t Left = end - start;
+    while (Left) {
+      int Len = JsonFile.read(Buffer, std::min<size_t>(Left, sizeof(Buffer)));
+      if ((Len <= 0) || (Output.write(Buffer, Len) != (size_t)Len)) {
+        WriteFail = true;
+        break;
       }
-      ESPAPP_DEBUGV("Json data written to '%s' (%s)\n", name.c_str(),
-                    ToString(bufofs, SizeUnit::BYTE, true).c_str());
+      Left -= Len;
     }
+    JsonFile.seek(Position, SeekSet);
+  };
+  auto Begin = [&]() {
+    if (Output) return true;
+    Output = dir.openFile(TempName, "w");
+    if (!Output) {
+      ESPAPP_DEBUG("WARNING: Unable to create temporary file '%s'\n", TempName.c_str());
+      return false;
+    }
+    if (Empty) Put(F("{"));
+    else CopyRaw(0, KeptEnd);
+    return !WriteFail;
+  };
+  auto Separate = [&]() {
+    Put(Members++? F(",\n  ") : F("\n  "));
+  };
+  auto Emit = [&](String const &key, String const &value) {
+    Separate();
+    Put(F("\""));
+    Put(key);
+    Put(F("\": "));
+    Put(value);
+  };
+  auto Abort = [&](JsonManagerResults result) {
+    if (Output) {
+      Output.close();
+      dir.remove(TempName);
+    }
+    if (result == JSONMAN_WARN_UPDATEFAIL) JsonManagerStats.Failed++;
+    return result;
+  };
+
+  if (!Empty) {
+    JsonStreamReader Reader(JsonFile);
+    if (Reader.skipSpace() != '{') return Abort(JSONMAN_ERR_MALSTOR);
+    Reader.next();
+    KeptEnd = Reader.offset();
+    bool First = true;
+    while (true) {
+      int c = Reader.skipSpace();
+      if (c == '}') {
+        Reader.next();
+        break;
+      }
+      if (!First) {
+        if (c != ',') return Abort(JSONMAN_ERR_MALSTOR);
+        Reader.next();
+        Reader.skipSpace();
+      }
+      First = false;
+
+      size_t MemberStart = Reader.offset();
+      String Key, Value;
+      bool LongKey;
+      if (!JsonStreamKey(Reader, Key, LongKey)) return Abort(JSONMAN_ERR_MALSTOR);
+      if (Reader.skipSpace() != ':') return Abort(JSONMAN_ERR_MALSTOR);
+      Reader.next();
+      Reader.skipSpace();
+      if (LongKey) {
+        ESPAPP_DEBUGV("WARNING: Json member key '%s...' too long, kept as is\n", Key.c_str());
+      }
+
+      // Values beyond the limit are passed on in chunks
+      JsonStreamAction Action = JSONSTREAM_KEEP;
+      bool Decided = !member_cb || LongKey, Chunked = false;
+      bool Scanned = JsonStreamScan(Reader, [&](char c) {
+        if (Decided) return;
+        if (Value.length() >= value_limit) {
+          Chunked = true;
+          Action = member_cb(Key, Value, true);
+          if (Action != JSONSTREAM_KEEP) {
+            Decided = true;
+            return;
+          }
+          Value.clear();
+        }
+        Value.concat(c);
+      });
+      if (!Scanned) return Abort(JSONMAN_ERR_MALSTOR);
+      if (!Decided) Action = member_cb(Key, Value, false);
+
+      if ((Action == JSONSTREAM_REPLACE) && !Value) Action = JSONSTREAM_REMOVE;
+      if (Action == JSONSTREAM_KEEP) {
+        if (!Output) {
+          Members++;
+          KeptEnd = Reader.offset();
+        } else if (Chunked || LongKey) {
+          Separate();
+          CopyRaw(MemberStart, Reader.offset());
+        } else Emit(Key, Value);
+      } else {
+        if (!Begin()) return Abort(JSONMAN_WARN_UPDATEFAIL);
+        if (Action == JSONSTREAM_REPLACE) Emit(Key, Value);
+      }
+      if (WriteFail) return Abort(JSONMAN_WARN_UPDATEFAIL);
+    }
+    if (Reader.skipSpace() >= 0) return Abort(JSONMAN_ERR_MALSTOR);
   }
-  return Ret;
+
+  // Append new members
+  while (append_cb) {
+    String Key, Value;
+    if (!append_cb(Key, Value) || !Key || !Value) break;
+    if (!Begin()) return Abort(JSONMAN_WARN_UPDATEFAIL);
+    Emit(Key, Value);
+  }
+
+  if (!Output) return JSONMAN_OK_READONLY;
+  Put(Members? F("\n}") : F("}"));
+  if (WriteFail) return Abort(JSONMAN_WARN_UPDATEFAIL);
+  size_t OutputSize = Output.size();
+  Output.close();
+  JsonFile.close();
+  if (!JsonReplaceFile(dir, name, TempName)) return JSONMAN_WARN_UPDATEFAIL;
+  ESPAPP_DEBUGV("Json data streamed to '%s' (%s)\n", name.c_str(),
+                ToString(OutputSize, SizeUnit::BYTE, true).c_str());
+  return JSONMAN_OK_UPDATED;
+}
+
+bool HashFile(fs::Dir &dir, String const &name, uint8_t *md5) {
+  fs::File HashData = dir.openFile(name, "r");
+  if (!HashData) return false;
+  MD5Builder Hasher;
+  Hasher.begin();
+  Hasher.addStream(HashData, HashData.size());
+  Hasher.calculate();
+  Hasher.getBytes(md5);
+  return true;
+}
+
+void DeriveWPAPMK(String const &SSID, String const &Pass, uint8_t *PMK) {
+  br_hmac_key_context KeyCtx;
+  br_hmac_key_init(&KeyCtx, &br_sha1_vtable, Pass.c_str(), Pass.length());
+
+  uint8_t Block = 0;
+  for (size_t ofs = 0; ofs < WPA_PMK_LEN; ofs += br_sha1_SIZE) {
+    uint8_t Count[4] = {0, 0, 0, ++Block};
+    uint8_t U[br_sha1_SIZE], T[br_sha1_SIZE];
+    br_hmac_context HMACCtx;
+    br_hmac_init(&HMACCtx, &KeyCtx, 0);
+    br_hmac_update(&HMACCtx, SSID.c_str(), SSID.length());
+    br_hmac_update(&HMACCtx, Count, sizeof(Count));
+    br_hmac_out(&HMACCtx, U);
+    memcpy(T, U, br_sha1_SIZE);
+    for (int i = 1; i < WPA_PBKDF2_ROUNDS; i++) {
+      br_hmac_init(&HMACCtx, &KeyCtx, 0);
+      br_hmac_update(&HMACCtx, U, br_sha1_SIZE);
+      br_hmac_out(&HMACCtx, U);
+      for (int j = 0; j < br_sha1_SIZE; j++) T[j] ^= U[j];
+      // Keep the WiFi stack serviced
+      if (!(i & 0xFF)) yield();
+    }
+    memcpy(PMK + ofs, T, std::min<size_t>(br_sha1_SIZE, WPA_PMK_LEN - ofs));
+  }
+}
+
+void LatencyStats::record(uint32_t spanUS) {
+  Count++;
+  TotalUS += spanUS;
+  if (spanUS > MaxUS) MaxUS = spanUS;
+
+  uint8_t Bucket = 0;
+  uint32_t Span = spanUS >> LATENCY_BUCKET_BASE;
+  while (Span && Bucket < LATENCY_BUCKETS - 1) {
+    Span >>= 1;
+    Bucket++;
+  }
+  Hist[Bucket]++;
+}
+
+uint32_t LatencyStats::percentile(uint8_t pct) const {
+  uint32_t Total = 0;
+  for (uint8_t i = 0; i < LATENCY_BUCKETS; i++) Total += Hist[i];
+  uint32_t Target = (Total * pct + 99) / 100;
+  uint32_t Accum = 0;
+  for (uint8_t i = 0; i < LATENCY_BUCKETS - 1; i++) {
+    Accum += Hist[i];
+    if (Accum && Accum >= Target)
+      return std::min<uint32_t>(MaxUS, 1u << (i + LATENCY_BUCKET_BASE));
+  }
+  return MaxUS;
+}
+
+void LatencyStats::printTo(JsonObject &obj) const {
+  obj[FL("count")] = Count;
+  obj[FL("avg")] = Count ? (uint32_t)(TotalUS / Count) : 0;
+  obj[FL("p50")] = percentile(50);
+  obj[FL("p99")] = percentile(99);
+  obj[FL("max")] = MaxUS;
 }
 
 String PrintMAC(uint8_t const *MAC) {
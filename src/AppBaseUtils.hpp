@@ -73,6 +73,78 @@ JsonManagerResults JsonManager(fs::Dir &dir, String const &name,
                                uint8_t nest_limit = JSON_MAXIMUM_PARSER_NEST,
                                size_t buf_limit = JSON_MAXIMUM_PARSER_BUFFER);
 
+// Replace the file content through a temporary file, skipped if the content is identical
+// A replacement interrupted by reset is completed or rolled back on next access
+bool JsonSaveFile(fs::Dir &dir, String const &name, String const &data);
+
+struct JsonWriteStats {
+  uint32_t Written;    // Files replaced
+  uint32_t Unchanged;  // Writes skipped, content identical
+  uint32_t Failed;
+  uint32_t Recovered;  // Interrupted replacements completed
+};
+
+extern JsonWriteStats JsonManagerStats;
+
+#define JSON_MAXIMUM_STREAM_KEY    64
+#define JSON_MAXIMUM_STREAM_VALUE  256
+#define JSON_STREAM_CHUNK          64
+#define JSON_STREAM_LITERAL        32
+#define JSON_STREAM_TEMP_EXT       ".tmp"
+
+typedef enum {
+  JSONSTREAM_KEEP,
+  JSONSTREAM_REPLACE,
+  JSONSTREAM_REMOVE,
+} JsonStreamAction;
+
+// Called for each top-level member, with the raw JSON text of its value. A value longer
+// than the value limit arrives in consecutive chunks, with `more` set on all but the
+// last one; returning other than JSONSTREAM_KEEP on a chunk decides early, and the rest
+// of the value is skipped. Set `value` and return JSONSTREAM_REPLACE to rewrite it.
+// Members with keys longer than JSON_MAXIMUM_STREAM_KEY are kept without a call.
+typedef std::function<JsonStreamAction(String const &key, String &value, bool more)>
+    JsonMemberCallback;
+
+// Called at the end of the object; set `key` and `value` and return true to append
+// a member, the call repeats until it returns false
+typedef std::function<bool(String &key, String &value)> JsonAppendCallback;
+
+// Visit or rewrite a json object file with bounded memory regardless of its size
+// Rewrites go through a temporary file, which replaces the original when complete;
+// malformed files are reported and left untouched
+JsonManagerResults JsonStreamManager(fs::Dir &dir, String const &name,
+                                     bool create_new_if_dne,
+                                     JsonMemberCallback const &member_cb,
+                                     JsonAppendCallback const &append_cb = JsonAppendCallback(),
+                                     size_t value_limit = JSON_MAXIMUM_STREAM_VALUE);
+
+// Check that the file holds a well-formed json object, without size or nesting limits
+bool JsonStreamCheck(fs::File &file);
+
+#define LATENCY_BUCKETS       16
+#define LATENCY_BUCKET_BASE   8   // First bucket covers [0, 2^8) us, last one [2^22, inf) us
+
+struct LatencyStats {
+  uint32_t Count;
+  uint32_t MaxUS;
+  uint64_t TotalUS;
+  uint32_t Hist[LATENCY_BUCKETS];
+
+  void record(uint32_t spanUS);
+  // Upper bound of the bucket containing the given percentile
+  uint32_t percentile(uint8_t pct) const;
+  void printTo(JsonObject &obj) const;
+};
+
+bool HashFile(fs::Dir &dir, String const &name, uint8_t *md5);
+
+#define WPA_PMK_LEN         32
+#define WPA_PBKDF2_ROUNDS   4096
+
+// Derive the WPA/WPA2 pairwise master key (PBKDF2-HMAC-SHA1) of a passphrase
+void DeriveWPAPMK(String const &SSID, String const &Pass, uint8_t *PMK);
+
 String PrintMAC(uint8_t const *MAC);
 String PrintIP(uint32_t const IP);
 String PrintAuth(AUTH_MODE const Auth);
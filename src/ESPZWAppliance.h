@@ -14,6 +14,16 @@
 #include <ESPAsyncWebServer.h>
 
 #include "AppBaseUtils.hpp"
+#include "RTCMemory.hpp"
+
+// Core reservation: the core regions (50 slots) plus a small headroom, so that
+// minor core additions do not move the user area
+#define APPLIANCE_RTCMEMORY_RESERVED   52
+// User area capacity: accessible slots, less the signature, the event log ring
+// (RTCMEMORY_RAWSLOTS, none by default) and the core reservation.
+// With the defaults this is 40 slots, down from 84 before the core cached its
+// boot states in RTC; enabling the event log takes another RTCMEMORY_RAWSLOTS.
+#define APPLIANCE_RTCMEMORY_USERSLOTS  (RTCMEMORY_USERSLOTS - APPLIANCE_RTCMEMORY_RESERVED)
 
 Dir Appliance_GetDir(String const &path);
 time_t Appliance_CurrentTS();
@@ -21,15 +31,36 @@ time_t Appliance_UTCTimeofDay(struct tm *tm_out = nullptr);
 time_t Appliance_LocalTimeofDay(struct tm *tm_out = nullptr,
 	TimeChangeRule **tcr = nullptr);
 
+// Configuration files are cached in memory after the first access
 JsonManagerResults Appliance_LoadConfig(String const &filename,
 	std::function<void(JsonObject const &obj)> const &callback);
+// Deferred updates are written back on Appliance_FlushConfig(), service teardown,
+// or device restart
 JsonManagerResults Appliance_UpdateConfig(String const &filename,
-	JsonObjectCallback const &callback);
+	JsonObjectCallback const &callback, bool deferred = false);
+bool Appliance_FlushConfig();
+// Visit or rewrite the top-level members of a configuration file with bounded memory,
+// for files too large for Appliance_LoadConfig()/Appliance_UpdateConfig()
+JsonManagerResults Appliance_StreamConfig(String const &filename,
+	JsonMemberCallback const &callback,
+	JsonAppendCallback const &append = JsonAppendCallback());
 
 bool Appliance_RTCMemory_isRestored();
 uint8_t Appliance_RTCMemory_Available();
+// Lay out user regions, should be called in setup() before accessing them
+// Use RTCRegionOffset() to address the data of each region, and
+// static_assert RTCRegionsSpan() against APPLIANCE_RTCMEMORY_USERSLOTS
+bool Appliance_RTCMemory_Attach(RTCRegion const *regions, uint8_t count);
 bool Appliance_RTCMemory_Read(uint8_t offset, uint32_t *buf, uint8_t count);
 bool Appliance_RTCMemory_Write(uint8_t offset, uint32_t *buf, uint8_t count);
+// Group several writes into a single RTC memory update
+void Appliance_RTCMemory_Begin();
+bool Appliance_RTCMemory_Commit();
+
+#define APPLIANCE_EVENT_CODE_MAX 0x7F
+
+// Append an event to the RTC event log, which survives watchdog and exception resets
+void Appliance_EventLog(uint8_t code, uint8_t arg = 0);
 
 AsyncWebServer* Appliance_WebPortal();
 void Appliance_WebPortal_TimedStart();
@@ -44,6 +75,31 @@ File Appliance_WebPortal_CheckRestoreRes(Dir &dir, String const &resfile,
 void Appliance_Service_Reload();
 void Appliance_Device_Restart();
 
+typedef std::function<void()> TaskCallback;
+
+#define APPLIANCE_TASK_NONE -1
+
+// Cooperative tasks, dispatched from the service loop
+// Between iterations the service loop sleeps until a task or timer is due, or a
+// system event arrives, but at most one second; loop() is not polled continuously
+// Returns task id, or APPLIANCE_TASK_NONE if no task slot is available
+int8_t Appliance_Schedule_Periodic(String const &name, uint32_t period_ms,
+	TaskCallback const &callback);
+int8_t Appliance_Schedule_Once(String const &name, uint32_t delay_ms,
+	TaskCallback const &callback);
+int8_t Appliance_Schedule_Deadline(String const &name, time_t deadline,
+	TaskCallback const &callback);
+bool Appliance_Schedule_Cancel(int8_t task);
+
+#define APPLIANCE_TIMER_NONE 0
+
+// Timers on the appliance timer wheel, callbacks are deferred to loop context
+// Returns timer id, or APPLIANCE_TIMER_NONE if no timer is available
+// All timers are cancelled when the service stops
+uint8_t Appliance_Timer_Start(uint32_t interval_ms, TaskCallback const &callback,
+	bool repeat = true);
+void Appliance_Timer_Stop(uint8_t timer);
+
 typedef enum {
 	AP_PHY_11b = 0x1,
 	AP_PHY_11g = 0x2,
@@ -1,26 +1,53 @@
 
 #include "RTCMemory.hpp"
 
+// CRC32 (IEEE 802.3), nibble table
+static uint32_t const CRC32_Nibble[16] = {
+	0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+	0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+	0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+	0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+static uint32_t calcCRC32(void const *data, size_t len) {
+	uint8_t const *ptr = (uint8_t const*)data;
+	uint32_t crc = ~0U;
+	while (len--) {
+		crc ^= *ptr++;
+		crc = (crc >> 4) ^ CRC32_Nibble[crc & 0xF];
+		crc = (crc >> 4) ^ CRC32_Nibble[crc & 0xF];
+	}
+	return ~crc;
+}
+
 RTCMemory::RTCMemory() {
 #if !RTCMEMORY_FULLBUFFER
 	RTCDATA _rtcData;
+#else
+	_txnDepth = 0;
 #endif
 	ESPAPPRTCM_DEBUGVV("Loading RTC memory...\n");
 	if (!ESP.rtcUserMemoryRead(RTCMEMORY_ARDUINORSV, (uint32_t*)&_rtcData, sizeof(RTCDATA))) {
 		ESPAPPRTCM_DEBUG("ERROR: Failed to load RTC memory\n");
 		panic();
 	}
-	uint8_t sig[MD5_BINLEN];
-	calcMD5(_rtcData.data, sizeof(_rtcData.data), sig);
-	if (memcmp(sig, _rtcData.sig, MD5_BINLEN) != 0) {
+	if (calcCRC32(_rtcData.data, sizeof(_rtcData.data)) != _rtcData.sig) {
 		ESPAPPRTCM_DEBUG("WARNING: RTC memory signature invalid\n");
 		memset(_rtcData.data, 0, sizeof(_rtcData.data));
-		calcMD5(_rtcData.data, sizeof(_rtcData.data), _rtcData.sig);
+		_rtcData.sig = calcCRC32(_rtcData.data, sizeof(_rtcData.data));
 		ESPAPPRTCM_DEBUGV("Initializing RTC memory...\n");
 		if (!ESP.rtcUserMemoryWrite(RTCMEMORY_ARDUINORSV, (uint32_t*)&_rtcData, sizeof(RTCDATA))) {
 			ESPAPPRTCM_DEBUG("ERROR: Failed to initialize RTC memory\n");
 			panic();
 		}
+#if RTCMEMORY_RAWSLOTS
+		uint32_t rawData[RTCMEMORY_RAWSLOTS];
+		memset(rawData, 0, sizeof(rawData));
+		if (!ESP.rtcUserMemoryWrite(RTCMEMORY_RAWSTART, rawData, sizeof(rawData))) {
+			ESPAPPRTCM_DEBUG("ERROR: Failed to initialize RTC memory\n");
+			panic();
+		}
+#endif
 	} else {
 		ESPAPPRTCM_DEBUGV("RTC memory signature valid\n");
 	}
@@ -40,41 +67,145 @@ bool RTCMemory::Read(uint8_t offset, uint32_t *buf, uint8_t count) {
 }
 
 bool RTCMemory::Write(uint8_t offset, uint32_t const *buf, uint8_t count) {
-#if RTCMEMORY_FULLBUFFER
 	if (offset+count > RTCMEMORY_USERSLOTS) {
 		ESPAPPRTCM_DEBUG("WARNING: Reject out-of-bound RTC memory write\n");
 		return false;
 	}
+#if RTCMEMORY_FULLBUFFER
+	// Nothing to do if content is unchanged
+	if (memcmp(_rtcData.data+offset, buf, count*4) == 0) return true;
+	memcpy(_rtcData.data+offset, buf, count*4);
+	if (_txnDepth) {
+		if (_dirtyStart == _dirtyEnd) {
+			_dirtyStart = offset;
+			_dirtyEnd = offset+count;
+		} else {
+			if (offset < _dirtyStart) _dirtyStart = offset;
+			if (offset+count > _dirtyEnd) _dirtyEnd = offset+count;
+		}
+		return true;
+	}
 #else
 	RTCDATA _rtcData;
 	ESPAPPRTCM_DEBUGVV("Loading RTC memory...\n");
 	ESP.rtcUserMemoryRead(RTCMEMORY_USERSTART, _rtcData.data, RTCMEMORY_USERSLOTS*4);
-#endif
 	memcpy(_rtcData.data+offset, buf, count*4);
+#endif
+	return _flush(_rtcData, offset, count);
+}
+
+bool RTCMemory::ReadRaw(uint8_t offset, uint32_t *buf, uint8_t count) {
+	if (offset+count > RTCMEMORY_RAWSLOTS) {
+		ESPAPPRTCM_DEBUG("WARNING: Reject out-of-bound RTC memory raw read\n");
+		return false;
+	}
+	return ESP.rtcUserMemoryRead(RTCMEMORY_RAWSTART+offset, buf, count*4);
+}
+
+bool RTCMemory::WriteRaw(uint8_t offset, uint32_t const *buf, uint8_t count) {
+	if (offset+count > RTCMEMORY_RAWSLOTS) {
+		ESPAPPRTCM_DEBUG("WARNING: Reject out-of-bound RTC memory raw write\n");
+		return false;
+	}
+	return ESP.rtcUserMemoryWrite(RTCMEMORY_RAWSTART+offset, (uint32_t*)buf, count*4);
+}
+
+#if RTCMEMORY_FULLBUFFER
+
+void RTCMemory::Begin() {
+	if (!_txnDepth++) _dirtyStart = _dirtyEnd = 0;
+}
+
+bool RTCMemory::Commit() {
+	if (!_txnDepth) {
+		ESPAPPRTCM_DEBUG("WARNING: Commit without matching Begin\n");
+		return false;
+	}
+	if (--_txnDepth) return true;
+	if (_dirtyStart == _dirtyEnd) return true;
+	return _flush(_rtcData, _dirtyStart, _dirtyEnd-_dirtyStart);
+}
+
+#else
+
+void RTCMemory::Begin() {}
+bool RTCMemory::Commit() { return true; }
+
+#endif
+
+bool RTCMemory::_flush(RTCDATA &rtcData, uint8_t offset, uint8_t count) {
 	ESPAPPRTCM_DEBUGVV("Recalculating RTC memory signature...\n");
-	calcMD5(_rtcData.data, sizeof(_rtcData.data), _rtcData.sig);
+	rtcData.sig = calcCRC32(rtcData.data, sizeof(rtcData.data));
 
 #if RTCMEMORY_FULLUPDATE
+	offset = 0;
+	count = RTCMEMORY_USERSLOTS;
+#endif
+	// Data goes before the signature, so an interrupted update invalidates the
+	// signature instead of leaving partial data valid; all signed contents,
+	// including slots not being updated, are then discarded on the next boot
 	ESPAPPRTCM_DEBUGVV("Updating RTC memory data...\n");
-	if (!ESP.rtcUserMemoryWrite(RTCMEMORY_USERSTART+offset, buf, count*4)) {
+	if (!ESP.rtcUserMemoryWrite(RTCMEMORY_USERSTART+offset, rtcData.data+offset, count*4)) {
 		ESPAPPRTCM_DEBUG("WARNING: Failed to update RTC memory data\n");
 		return false;
 	}
 	ESPAPPRTCM_DEBUGVV("Updating RTC memory signature...\n");
-	if (!ESP.rtcUserMemoryWrite(RTCMEMORY_ARDUINORSV, _rtcData.sig, MD5_BINLEN)) {
+	if (!ESP.rtcUserMemoryWrite(RTCMEMORY_ARDUINORSV, &rtcData.sig, sizeof(rtcData.sig))) {
 		ESPAPPRTCM_DEBUG("ERROR: Failed to update RTC memory signature\n");
 		panic();
 	}
-#else
-	ESPAPPRTCM_DEBUGVV("Updating RTC memory...\n");
-	if (!ESP.rtcUserMemoryWrite(RTCMEMORY_ARDUINORSV, (uint32_t*)&_rtcData, sizeof(RTCDATA))) {
-		ESPAPPRTCM_DEBUG("ERROR: Failed to update RTC memory\n");
-		panic();
-	}
-#endif
 	return true;
 }
 
+static uint32_t RTCRegionHeader(RTCRegion const &region) {
+	uint8_t check = region.id ^ region.version ^ region.slots ^ RTCREGION_CHECK;
+	return (region.id << 24) | (region.version << 16) | (region.slots << 8) | check;
+}
+
+bool RTCMemory::Attach(uint8_t base, uint8_t limit, RTCRegion const *regions, uint8_t count) {
+	uint8_t span = RTCRegionsSpan(regions, count);
+	if (span > limit || base+span > RTCMEMORY_USERSLOTS) {
+		ESPAPPRTCM_DEBUG("WARNING: RTC memory regions exceed capacity (%d > %d)\n", span, limit);
+		return false;
+	}
+
+	uint32_t image[span];
+	memset(image, 0, sizeof(image));
+	for (uint8_t idx = 0; idx < count; idx++) {
+		RTCRegion const &region = regions[idx];
+		uint8_t offset = RTCRegionOffset(regions, idx);
+		image[offset-RTCREGION_HEADER] = RTCRegionHeader(region);
+
+		// Locate the stored copy by walking the existing headers
+		uint8_t pos = 0;
+		while (pos+RTCREGION_HEADER <= limit) {
+			uint32_t header;
+			if (!Read(base+pos, &header, 1)) break;
+			RTCRegion stored = {
+				(uint8_t)(header >> 24), (uint8_t)(header >> 16), (uint8_t)(header >> 8) };
+			if (!stored.id || header != RTCRegionHeader(stored)) break;
+			if (pos+RTCREGION_HEADER+stored.slots > limit) break;
+			if (stored.id == region.id) {
+				if (stored.version == region.version && stored.slots == region.slots) {
+					if (!Read(base+pos+RTCREGION_HEADER, image+offset, region.slots)) break;
+					if (pos+RTCREGION_HEADER != offset) {
+						ESPAPPRTCM_DEBUGV("RTC memory region #%d relocated\n", region.id);
+					}
+				} else {
+					ESPAPPRTCM_DEBUG("WARNING: RTC memory region #%d layout changed, cleared\n",
+						region.id);
+				}
+				break;
+			}
+			pos += RTCREGION_HEADER+stored.slots;
+		}
+	}
+
+	Begin();
+	Write(base, image, span);
+	return Commit();
+}
+
 RTCMemory & RTCMemory::Manager() {
 	static RTCMemory __IoFU; // Initialize on first use
 	return __IoFU;
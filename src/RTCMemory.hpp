@@ -42,6 +42,7 @@
 #define RTCMEMORY_MAXLEN     512
 
 #define RTCMEMORY_FULLBUFFER 1
+// Rewrite the entire RTC block on every update, instead of only the updated slots
 //#define RTCMEMORY_FULLUPDATE 1
 
 #ifndef RTCMEMORY_FULLBUFFER
@@ -55,13 +56,43 @@
 #define RTCMEMORY_TOTALSLOTS  (RTCMEMORY_MAXLEN/4)
 #define RTCMEMORY_ARDUINORSV  (sizeof(struct eboot_command)/4)
 #define RTCMEMORY_ACCESSSLOTS (RTCMEMORY_TOTALSLOTS-RTCMEMORY_ARDUINORSV)
-#define RTCMEMORY_USERSLOTS   (RTCMEMORY_ACCESSSLOTS-(MD5_BINLEN/4))
-#define RTCMEMORY_USERSTART   (RTCMEMORY_TOTALSLOTS-RTCMEMORY_USERSLOTS)
+#define RTCMEMORY_SIGSLOTS    1   // CRC32 of user slots
+
+#ifndef RTCMEMORY_RAWSLOTS
+// Slots at the end not covered by the signature, for self-checking append-only data
+// Taken from the user slots; opt-in, define e.g. as 16 to enable the event log
+#define RTCMEMORY_RAWSLOTS    0
+#endif
+
+#define RTCMEMORY_USERSLOTS   (RTCMEMORY_ACCESSSLOTS-RTCMEMORY_SIGSLOTS-RTCMEMORY_RAWSLOTS)
+#define RTCMEMORY_USERSTART   (RTCMEMORY_ARDUINORSV+RTCMEMORY_SIGSLOTS)
+#define RTCMEMORY_RAWSTART    (RTCMEMORY_TOTALSLOTS-RTCMEMORY_RAWSLOTS)
+
+// Named and versioned region, laid out as a header slot followed by data slots
+struct RTCRegion {
+	uint8_t id;       // Stable identifier, 0 is reserved
+	uint8_t version;  // Bump when the data layout changes
+	uint8_t slots;
+};
+
+#define RTCREGION_HEADER  1
+#define RTCREGION_CHECK   0xA5
+
+// Total slots occupied by the first `count` regions
+constexpr uint8_t RTCRegionsSpan(RTCRegion const *regions, uint8_t count) {
+	return count? RTCRegionsSpan(regions, count-1) +
+		RTCREGION_HEADER + regions[count-1].slots : 0;
+}
+
+// Offset of the data slots of region at `index`
+constexpr uint8_t RTCRegionOffset(RTCRegion const *regions, uint8_t index) {
+	return RTCRegionsSpan(regions, index) + RTCREGION_HEADER;
+}
 
 class RTCMemory {
 	protected:
 		struct RTCDATA {
-			uint8_t sig[MD5_BINLEN];
+			uint32_t sig;
 			uint32_t data[RTCMEMORY_USERSLOTS];
 		}
 #if RTCMEMORY_FULLBUFFER
@@ -69,6 +100,14 @@ class RTCMemory {
 #endif
 		;
 
+#if RTCMEMORY_FULLBUFFER
+		uint8_t _txnDepth;
+		uint8_t _dirtyStart;
+		uint8_t _dirtyEnd;
+#endif
+
+		static bool _flush(RTCDATA &rtcData, uint8_t offset, uint8_t count);
+
 		RTCMemory();
 
 	public:
@@ -76,6 +115,24 @@ class RTCMemory {
 
 		bool Read(uint8_t offset, uint32_t *buf, uint8_t count);
 		bool Write(uint8_t offset, uint32_t const *buf, uint8_t count);
+
+		// Coalesce writes until the matching Commit() into one signature update and flush
+		// Note: Without RTCMEMORY_FULLBUFFER, writes are not deferred
+		// Note: A flush is not atomic, there is no copy of the previous contents;
+		//       a reset in the middle of one invalidates the signature, and ALL signed
+		//       slots (every region, not just the updated ones) are cleared on next boot
+		void Begin();
+		bool Commit();
+
+		// Direct access to the unsigned slots, no buffering or signature update
+		// Note: Content is only cleared when the signed slots are found invalid
+		bool ReadRaw(uint8_t offset, uint32_t *buf, uint8_t count);
+		bool WriteRaw(uint8_t offset, uint32_t const *buf, uint8_t count);
+
+		// Lay out regions starting at `base`, within `limit` slots
+		// Regions found with matching id and version are kept (and relocated if moved),
+		// others are cleared
+		bool Attach(uint8_t base, uint8_t limit, RTCRegion const *regions, uint8_t count);
 };
 
 #endif //__RTCMEMORY_H__
@@ -14,6 +14,11 @@ extern "C" {
 #include <ESP8266WiFi.h>
 #include <DNSServer.h>
 
+#include <lwip/netif.h>
+#include <lwip/dhcp.h>
+#include <lwip/tcp.h>
+#include <lwip/priv/tcp_priv.h>
+
 #include <ArduinoJson.h>
 
 #include <LinkedList.h>
@@ -25,6 +30,8 @@ extern "C" {
 #include <ESPAsyncWebServer.h>
 #include <AsyncJsonResponse.h>
 
+#include <MD5Builder.h>
+
 #include "AppBaseUtils.hpp"
 #include "ZWApplianceRes.hpp"
 #include "RTCMemory.hpp"
@@ -41,17 +48,65 @@ extern "C" {
 #define WLAN_PORTAL_GATEWAY IPAddress(0, 0, 0, 0)
 #endif
 
-#define RTC_SLOTS_RESERVED      8
+#define RTC_SLOTS_RESERVED      APPLIANCE_RTCMEMORY_RESERVED
 
-#define RTC_SLOT_FLAGS          0
+#define RTC_SLOT_FLAGS          RTCRegionOffset(RTCCoreRegions, RTCREGION_FLAGS)
 #define RTC_FLAG_BOOTFAIL       0x00000001
 #define RTC_FLAG_TIMESYNC       0x00000002
 #define RTC_FLAG_RESTORED       0x80000000
 
-#define RTC_SLOT_LASTKNOWNTS    1
-#define RTC_CLOCKUPDATE         15  // Update RTC last known clock every 15 seconds
+#define RTC_SLOT_CLOCKANCHOR    RTCRegionOffset(RTCCoreRegions, RTCREGION_CLOCKANCHOR)
+#define RTC_CLOCKANCHOR_SLOTS   4
+#define RTC_CLOCKANCHOR_REFRESH 3600  // Re-anchor RTC clock every hour, well before the counter wraps
+#ifndef RTC_CLOCKCOARSE_REFRESH
+// Seconds between coarse clock saves, bounds the clock regression after an external
+// reset (which restarts the counter); each save re-signs RTC memory, 0 to disable
+#define RTC_CLOCKCOARSE_REFRESH 300
+#endif
+
+#define RTC_SLOT_CFGSNAPSHOT    RTCRegionOffset(RTCCoreRegions, RTCREGION_CFGSNAPSHOT)
+#define RTC_CFGSNAPSHOT_SLOTS   13
+
+#define CFGSNAPSHOT_MAGIC         0x5A
+#define CFGSNAPSHOT_HOSTNAME_LEN  32
+
+#define RTC_SLOT_WLANLEASE      RTCRegionOffset(RTCCoreRegions, RTCREGION_WLANLEASE)
+#define RTC_WLANLEASE_SLOTS     7
+
+#define RTC_SLOT_BOOTTRACE      RTCRegionOffset(RTCCoreRegions, RTCREGION_BOOTTRACE)
+#define RTC_BOOTTRACE_SLOTS     (BOOTTRACE_DEPTH * BOOTTRACE_RECORD_SLOTS)
+
+#define BOOTTRACE_DEPTH         2   // Number of boots kept in the boot trace ring
+#define BOOTTRACE_RECORD_SLOTS  (1 + BOOTTRACE_POINTS)
+#define BOOTTRACE_MAGIC         0xB7
+
+#define EVENTLOG_RECORD_SLOTS   2
+#define EVENTLOG_DEPTH          (RTCMEMORY_RAWSLOTS / EVENTLOG_RECORD_SLOTS)
+#define EVENTLOG_MAGIC          0xE5
+#define EVENTLOG_TIME_SHIFT     4   // Record uptime in units of 16 milliseconds
+
+#define WLAN_LEASE_REUSE_MAX      3   // Consecutive boots a cached lease may be reused without DHCP
+#define WLAN_FASTCONNECT_TIMEOUT  5   // Seconds to wait for fast reconnect before falling back
+#define WLAN_LEASE_RENEW_TIMEOUT  30  // Seconds to wait for DHCP to confirm a reused lease
+
+#define LOOP_IDLE_MAXIMUM   1000  // Milliseconds to idle when waiting for events
+#define LOOP_IDLE_POLL      100   // Milliseconds to idle when polling without event source
+
+#define WHEEL_TICK_MS       100   // Resolution of the timer wheel
+#define WHEEL_SLOTS         16    // Number of wheel slots, timers are hashed by expiry tick
+#define WHEEL_TIMERS        12    // Maximum number of concurrent wheel timers
+#define WHEEL_TIMER_NONE    APPLIANCE_TIMER_NONE
+#define WHEEL_ARM_MAXIMUM   3600000 // Milliseconds, longest single SDK timer arming
+
+#define WORK_QUEUE_DEPTH    16    // Deferred jobs posted from system context, power of 2
+#define WORK_QUEUE_RESERVED 4     // Entries only WiFi connection events may take
+
+#define CONFIG_CACHE_SLOTS  4     // Configuration files kept in memory for Appliance_*Config()
+#define CONFIG_CACHE_BYTES  2048  // Heap budget for cached configuration data
 
 #define SDKBUG_LIGHTSLEEP_POLL
+// Start associating with SDK stored credential before mounting file system
+#define WLAN_EARLY_ASSOCIATION
 
 typedef enum {
 	APP_STARTUP = 0,
@@ -62,7 +117,6 @@ typedef enum {
 	APP_DEVRESTART,
 } AppState;
 
-ESPAPP_DEBUGDO(
 static PGM_P StrAppState(AppState state) {
 	switch (state) {
 		case APP_STARTUP: return PSTR_L("Startup");
@@ -74,7 +128,83 @@ static PGM_P StrAppState(AppState state) {
 		default: return PSTR_L("<Unknown>");
 	}
 }
-)
+
+typedef enum {
+	BOOTTRACE_RTC = 0,
+	BOOTTRACE_CLOCK,
+	BOOTTRACE_FS,
+	BOOTTRACE_CONFIG,
+	BOOTTRACE_WIFI,
+	BOOTTRACE_SETUP,
+	BOOTTRACE_INIT,
+	BOOTTRACE_PORTAL,
+	BOOTTRACE_SERVICE,
+	BOOTTRACE_POINTS
+} BootTracePoint;
+
+// Core RTC memory regions, in layout order
+typedef enum {
+	RTCREGION_FLAGS = 0,
+	RTCREGION_CLOCKANCHOR,
+	RTCREGION_CFGSNAPSHOT,
+	RTCREGION_WLANLEASE,
+	RTCREGION_BOOTTRACE,
+	RTCREGION_COUNT
+} RTCCoreRegion;
+
+static constexpr RTCRegion RTCCoreRegions[RTCREGION_COUNT] = {
+	{ 1, 1, 1 },                    // Flags
+	{ 2, 3, RTC_CLOCKANCHOR_SLOTS },  // Clock anchor
+	{ 3, 1, RTC_CFGSNAPSHOT_SLOTS },  // Configuration snapshot
+	{ 4, 1, RTC_WLANLEASE_SLOTS },    // WLAN lease
+	{ 5, 1, RTC_BOOTTRACE_SLOTS },    // Boot trace
+};
+
+static_assert(RTCRegionsSpan(RTCCoreRegions, RTCREGION_COUNT) <= RTC_SLOTS_RESERVED,
+	"Core RTC memory regions exceed reserved slots");
+static_assert(RTC_SLOTS_RESERVED == APPLIANCE_RTCMEMORY_RESERVED,
+	"Core RTC reservation does not match the published user area");
+
+static PGM_P StrBootTracePoint(BootTracePoint point) {
+	switch (point) {
+		case BOOTTRACE_RTC: return PSTR_L("rtc");
+		case BOOTTRACE_CLOCK: return PSTR_L("clock");
+		case BOOTTRACE_FS: return PSTR_L("fs");
+		case BOOTTRACE_CONFIG: return PSTR_L("config");
+		case BOOTTRACE_WIFI: return PSTR_L("wifi");
+		case BOOTTRACE_SETUP: return PSTR_L("setup");
+		case BOOTTRACE_INIT: return PSTR_L("init");
+		case BOOTTRACE_PORTAL: return PSTR_L("portal");
+		case BOOTTRACE_SERVICE: return PSTR_L("service");
+		default: return PSTR_L("<Unknown>");
+	}
+}
+
+typedef enum {
+	EVENT_NONE = 0,
+	EVENT_BOOT,
+	EVENT_STATE,
+	EVENT_WLAN_DISCONNECT,
+	EVENT_PORTAL_START,
+	EVENT_PORTAL_STOP,
+	EVENT_OTA_BEGIN,
+	EVENT_OTA_END,
+	EVENT_USER = 0x80,
+} EventType;
+
+static PGM_P StrEventType(EventType type) {
+	if (type & EVENT_USER) return PSTR_L("user");
+	switch (type) {
+		case EVENT_BOOT: return PSTR_L("boot");
+		case EVENT_STATE: return PSTR_L("state");
+		case EVENT_WLAN_DISCONNECT: return PSTR_L("wlan-disconnect");
+		case EVENT_PORTAL_START: return PSTR_L("portal-start");
+		case EVENT_PORTAL_STOP: return PSTR_L("portal-stop");
+		case EVENT_OTA_BEGIN: return PSTR_L("ota-begin");
+		case EVENT_OTA_END: return PSTR_L("ota-end");
+		default: return PSTR_L("<Unknown>");
+	}
+}
 
 typedef enum {
 	INIT_STA_CONNECT = 0,
@@ -116,15 +246,19 @@ static struct {
 			InitSteps steps;
 			uint8_t cycleCount;
 			bool authFailure;
+			bool fastConnect;
+			bool fastFailure;
 		} init;
 		struct {
-			Ticker* apTestTimer;
+			uint8_t apTestTimer;
 			AsyncUDP* dnsServer;
+			time_t apTestTS;
 			bool performAPTest;
+			bool apScanRequest;
 		} portal;
 		struct {
-			Ticker* portalTimer;
-			Ticker* apTestTimer;
+			uint8_t portalTimer;
+			uint8_t apTestTimer;
 			time_t lastAPAvailableTS;
 			bool portalFallback;
 			bool reload;
@@ -132,8 +266,22 @@ static struct {
 	};
 } AppGlobal;
 
+#define STAGE_LOG_DEPTH   8   // Number of finished states to keep timing records
+
+static struct {
+	uint32_t SetupMS;
+	uint32_t StageMS;
+	uint16_t Count;
+	struct {
+		AppState State;
+		uint32_t StartMS;
+		uint32_t SpanMS;
+	} Log[STAGE_LOG_DEPTH];
+} StageStats;
+
 static uint32_t RTCFlags;
-static Ticker RTCClockUpdate;
+static uint8_t RTCClockUpdate = WHEEL_TIMER_NONE;
+static uint8_t RTCClockCoarse = WHEEL_TIMER_NONE;
 
 static TAPList APList(nullptr);
 static time_t APScanLast;
@@ -147,6 +295,84 @@ static WiFiDisconnectReason APLastDisconnectReason;
 
 static bool APScanInProgress;
 
+#define SERVICE_TASK_SLOTS  8   // Maximum number of scheduled user tasks
+
+typedef enum {
+	TASK_FREE = 0,
+	TASK_PERIODIC,
+	TASK_ONCE,
+	TASK_DEADLINE,
+} TaskType;
+
+static PGM_P StrTaskType(TaskType type) {
+	switch (type) {
+		case TASK_FREE: return PSTR_L("Free");
+		case TASK_PERIODIC: return PSTR_L("Periodic");
+		case TASK_ONCE: return PSTR_L("Once");
+		case TASK_DEADLINE: return PSTR_L("Deadline");
+		default: return PSTR_L("???");
+	}
+}
+
+struct ServiceTask {
+	TaskType Type;
+	uint16_t Seq;
+	String Name;
+	TaskCallback Callback;
+	uint32_t PeriodMS;
+	uint32_t DueMS;
+	time_t DueTS;
+	LatencyStats Runtime;
+};
+
+static ServiceTask ServiceTasks[SERVICE_TASK_SLOTS];
+static int8_t ServiceTaskRunning = APPLIANCE_TASK_NONE;
+
+#define LOOP_STATS_STATES   (APP_SERVICE + 1)
+
+// User callback duration and loop iteration gap, per looping state
+// Requested idling is excluded from the gaps and accounted separately
+static struct {
+	uint32_t SinceMS;
+	uint32_t LastUS;
+	uint32_t IdleUS;
+	bool Started;
+	LatencyStats User[LOOP_STATS_STATES];
+	LatencyStats Gap[LOOP_STATS_STATES];
+	uint64_t IdleTotalUS[LOOP_STATS_STATES];
+} LoopStats;
+
+static void LoopStats_Reset() {
+	memset(LoopStats.User, 0, sizeof(LoopStats.User));
+	memset(LoopStats.Gap, 0, sizeof(LoopStats.Gap));
+	memset(LoopStats.IdleTotalUS, 0, sizeof(LoopStats.IdleTotalUS));
+	LoopStats.SinceMS = millis();
+}
+
+#define WLAN_REASON_DEPTH   8   // Number of recent disconnect reasons to keep
+
+static struct {
+	uint32_t OnlineMS;
+	uint32_t DownMS;
+	uint16_t Disconnects;
+	uint16_t Reconnects;
+	uint32_t ReconnectTotalMS;
+	uint32_t ReconnectMaxMS;
+	uint16_t PortalCount;
+	uint32_t PortalTotalMS;
+	uint16_t ReasonCount;
+	uint8_t Reasons[WLAN_REASON_DEPTH];
+	bool Leaving;
+} WLANStats;
+
+// Deliberate disconnections (e.g. portal fallback) are not outages,
+// time spent without STA must not count as reconnection latency
+static void WLANStats_Leave() {
+	// Only an established link reports the disconnection
+	WLANStats.Leaving = WiFi.isConnected();
+	WLANStats.DownMS = 0;
+}
+
 typedef enum {
 	WPS_IDLE = 0,
 	WPS_SUCCESS,
@@ -161,6 +387,7 @@ static WPSStatusCode WPSStatus;
 
 #ifdef SDKBUG_LIGHTSLEEP_POLL
 
+// Stays in system context, must not depend on loop dispatch
 static Ticker LWIPTimer;
 extern "C" {
 	void sys_check_timeouts(void);
@@ -176,6 +403,257 @@ static void LWIP_TIMER_POLL(void) {
 
 #endif
 
+extern "C" {
+	void esp_yield(void);
+	void esp_schedule(void);
+}
+
+// Main loop idling, wakes up on deadline or events posted from system context
+static Ticker LoopIdleTimer;
+static volatile bool LoopIdling = false;
+static volatile bool LoopWakeup = false;
+
+static void Loop_Wakeup() {
+	LoopWakeup = true;
+	if (LoopIdling) {
+		LoopIdling = false;
+		esp_schedule();
+	}
+}
+
+static void Loop_Idle(uint32_t ms) {
+	if (!LoopWakeup) {
+		uint32_t IdleUS = micros();
+		LoopIdling = true;
+		LoopIdleTimer.once_ms(ms, Loop_Wakeup);
+		esp_yield();
+		LoopIdleTimer.detach();
+		LoopIdling = false;
+		LoopStats.IdleUS += micros() - IdleUS;
+	} else yield();
+	LoopWakeup = false;
+}
+
+// Single-producer (system context) single-consumer (loop context) job queue
+typedef void (*WorkFunc)(uint32_t arg);
+
+struct WorkItem {
+	WorkFunc Func;
+	uint32_t Arg;
+};
+
+static struct {
+	WorkItem Items[WORK_QUEUE_DEPTH];
+	volatile uint16_t Head;
+	volatile uint16_t Tail;
+	uint16_t Peak;
+	uint32_t Posted;
+	uint32_t Dropped;
+} WorkQueue;
+
+static_assert((WORK_QUEUE_DEPTH & (WORK_QUEUE_DEPTH - 1)) == 0,
+	"Work queue depth must be a power of 2");
+
+static bool Work_Post(WorkFunc func, uint32_t arg, bool reserved = false) {
+	uint16_t Tail = WorkQueue.Tail;
+	uint16_t Pending = Tail - WorkQueue.Head;
+	if (Pending >= (reserved? WORK_QUEUE_DEPTH : WORK_QUEUE_DEPTH - WORK_QUEUE_RESERVED)) {
+		WorkQueue.Dropped++;
+		return false;
+	}
+	WorkQueue.Items[Tail % WORK_QUEUE_DEPTH] = {func, arg};
+	// Publish the item only after it is written
+	__sync_synchronize();
+	WorkQueue.Tail = Tail + 1;
+	WorkQueue.Posted++;
+	if (++Pending > WorkQueue.Peak) WorkQueue.Peak = Pending;
+	Loop_Wakeup();
+	return true;
+}
+
+static void Work_Drain() {
+	uint16_t Head = WorkQueue.Head;
+	while (Head != WorkQueue.Tail) {
+		WorkItem Item = WorkQueue.Items[Head % WORK_QUEUE_DEPTH];
+		__sync_synchronize();
+		WorkQueue.Head = ++Head;
+		Item.Func(Item.Arg);
+	}
+}
+
+// Timer wheel driven by a single one-shot SDK timer, armed for the earliest
+// expiry only (no periodic tick); callbacks are dispatched in loop context
+struct WheelTimer {
+	TaskCallback Callback;
+	uint32_t PeriodTicks;
+	uint32_t ExpiryTick;
+	uint8_t Next;
+	bool Active;
+	bool User;
+};
+
+static struct {
+	Ticker Driver;
+	uint32_t Tick;
+	uint32_t TickMS;
+	uint32_t Done;
+	uint8_t Armed;
+	uint8_t Running;
+	volatile bool Missed;
+	uint8_t Slots[WHEEL_SLOTS];
+	WheelTimer Timers[WHEEL_TIMERS];
+} TimerWheel;
+
+static void Wheel_Dispatch();
+
+static void Wheel_DispatchJob(uint32_t) {
+	Wheel_Dispatch();
+}
+
+static void Wheel_Fire() {
+	if (!Work_Post(Wheel_DispatchJob, 0)) {
+		// Picked up by the main loop instead
+		TimerWheel.Missed = true;
+		Loop_Wakeup();
+	}
+}
+
+// Advance the wheel time from the system clock (loop context only)
+static uint32_t Wheel_Now() {
+	uint32_t Ticks = (millis() - TimerWheel.TickMS) / WHEEL_TICK_MS;
+	TimerWheel.Tick += Ticks;
+	TimerWheel.TickMS += Ticks * WHEEL_TICK_MS;
+	return TimerWheel.Tick;
+}
+
+// Arm the driver for the earliest expiry, or stop it when idle
+static void Wheel_Arm() {
+	if (!TimerWheel.Armed) {
+		TimerWheel.Driver.detach();
+		return;
+	}
+	uint32_t Now = Wheel_Now();
+	uint32_t Next = Now + WHEEL_ARM_MAXIMUM / WHEEL_TICK_MS;
+	for (uint8_t id = 1; id <= WHEEL_TIMERS; id++) {
+		WheelTimer &Timer = TimerWheel.Timers[id - 1];
+		if (!Timer.Active || id == TimerWheel.Running) continue;
+		if ((int32_t)(Timer.ExpiryTick - Next) < 0) Next = Timer.ExpiryTick;
+	}
+	// Far expiries simply take a few empty dispatches
+	int32_t Delay = (int32_t)(TimerWheel.TickMS + (Next - Now) * WHEEL_TICK_MS - millis());
+	TimerWheel.Driver.once_ms(Delay > 0? Delay : 1, Wheel_Fire);
+}
+
+static void Wheel_Link(uint8_t id) {
+	WheelTimer &Timer = TimerWheel.Timers[id - 1];
+	uint8_t &Head = TimerWheel.Slots[Timer.ExpiryTick % WHEEL_SLOTS];
+	Timer.Next = Head;
+	Head = id;
+}
+
+static void Wheel_Unlink(uint8_t id) {
+	WheelTimer &Timer = TimerWheel.Timers[id - 1];
+	uint8_t *Link = &TimerWheel.Slots[Timer.ExpiryTick % WHEEL_SLOTS];
+	while (*Link) {
+		if (*Link == id) {
+			*Link = Timer.Next;
+			break;
+		}
+		Link = &TimerWheel.Timers[*Link - 1].Next;
+	}
+	Timer.Next = WHEEL_TIMER_NONE;
+}
+
+static uint8_t Wheel_Start(uint32_t interval_ms, TaskCallback const &callback,
+	bool repeat) {
+	if (!callback) return WHEEL_TIMER_NONE;
+	for (uint8_t id = 1; id <= WHEEL_TIMERS; id++) {
+		WheelTimer &Timer = TimerWheel.Timers[id - 1];
+		// Do not overwrite the callback that is currently running
+		if (Timer.Active || id == TimerWheel.Running) continue;
+
+		uint32_t Now = Wheel_Now();
+		if (!TimerWheel.Armed++) TimerWheel.Done = Now;
+		uint32_t Ticks = (interval_ms + WHEEL_TICK_MS - 1) / WHEEL_TICK_MS;
+		if (!Ticks) Ticks = 1;
+		Timer.Callback = callback;
+		Timer.PeriodTicks = repeat? Ticks : 0;
+		Timer.ExpiryTick = Now + Ticks;
+		Timer.Active = true;
+		Timer.User = false;
+		Wheel_Link(id);
+		// Re-armed when the dispatch finishes
+		if (!TimerWheel.Running) Wheel_Arm();
+		return id;
+	}
+	ESPAPP_DEBUG("WARNING: No timer available on the wheel\n");
+	return WHEEL_TIMER_NONE;
+}
+
+static void Wheel_Stop(uint8_t id) {
+	if (id == WHEEL_TIMER_NONE || id > WHEEL_TIMERS) return;
+	WheelTimer &Timer = TimerWheel.Timers[id - 1];
+	if (!Timer.Active) return;
+
+	Timer.Active = false;
+	if (id != TimerWheel.Running) {
+		Wheel_Unlink(id);
+		Timer.Callback = nullptr;
+	}
+	--TimerWheel.Armed;
+	if (!TimerWheel.Running) Wheel_Arm();
+}
+
+// Cancel all timers started through the user-app API
+static void Wheel_StopUser() {
+	for (uint8_t id = 1; id <= WHEEL_TIMERS; id++) {
+		if (TimerWheel.Timers[id - 1].User) Wheel_Stop(id);
+	}
+}
+
+static void Wheel_Dispatch() {
+	TimerWheel.Missed = false;
+	uint32_t Now = Wheel_Now();
+	// Each slot needs visiting at most once, however long since last dispatch
+	uint32_t Span = Now - TimerWheel.Done;
+	if (Span > WHEEL_SLOTS) Span = WHEEL_SLOTS;
+	for (; Span; Span--) {
+		uint32_t Tick = Now - Span + 1;
+		uint8_t *Link = &TimerWheel.Slots[Tick % WHEEL_SLOTS];
+		while (*Link) {
+			uint8_t id = *Link;
+			WheelTimer &Timer = TimerWheel.Timers[id - 1];
+			if ((int32_t)(Now - Timer.ExpiryTick) < 0) {
+				Link = &Timer.Next;
+				continue;
+			}
+			*Link = Timer.Next;
+			Timer.Next = WHEEL_TIMER_NONE;
+
+			TimerWheel.Running = id;
+			Timer.Callback();
+			TimerWheel.Running = WHEEL_TIMER_NONE;
+
+			if (!Timer.Active) {
+				// Stopped during the callback
+				Timer.Callback = nullptr;
+			} else if (Timer.PeriodTicks) {
+				// Skip missed periods rather than firing in bursts
+				Timer.ExpiryTick += Timer.PeriodTicks;
+				if ((int32_t)(Now - Timer.ExpiryTick) >= 0)
+					Timer.ExpiryTick = Now + Timer.PeriodTicks;
+				Wheel_Link(id);
+			} else {
+				Timer.Callback = nullptr;
+				Timer.Active = false;
+				--TimerWheel.Armed;
+			}
+		}
+	}
+	TimerWheel.Done = Now;
+	Wheel_Arm();
+}
+
 time_t GetCurrentTS() {
 	struct timeval TV;
 	gettimeofday(&TV, nullptr);
@@ -192,6 +670,7 @@ static struct {
 
 	String WLAN_AP_Name;
 	String WLAN_AP_Pass;
+	String WLAN_AP_PMK;
 	unsigned int Init_Retry_Count;
 	unsigned int Init_Retry_Cycle;
 
@@ -214,6 +693,10 @@ static String PrintTime(time_t ts) {
 }
 
 static void Portal_Stop();
+static void BootTrace_Mark(BootTracePoint point);
+static void EventLog_Append(EventType type, uint8_t arg);
+static void Service_ClearTasks();
+static bool ConfigCache_FlushAll();
 
 extern void __userapp_setup();
 extern void __userapp_prestart_loop();
@@ -232,16 +715,19 @@ static time_t FinalizeCurrentState() {
 			break;
 
 		case APP_PORTAL:
-			delete AppGlobal.portal.apTestTimer;
+			Wheel_Stop(AppGlobal.portal.apTestTimer);
 			delete AppGlobal.portal.dnsServer;
+			WLANStats.PortalTotalMS += millis() - StageStats.StageMS;
 			break;
 
 		case APP_SERVICE:
-			delete AppGlobal.service.portalTimer;
-			delete AppGlobal.service.apTestTimer;
+			Wheel_Stop(AppGlobal.service.portalTimer);
+			Wheel_Stop(AppGlobal.service.apTestTimer);
 
 			if (!AppGlobal.NoService)
 				__userapp_teardown();
+			Service_ClearTasks();
+			ConfigCache_FlushAll();
 			break;
 
 		case APP_DEVRESET:
@@ -260,6 +746,14 @@ static time_t FinalizeCurrentState() {
 	time_t curTS = GetCurrentTS();
 	ESPAPP_DEBUG("End of state [%s] (%s)\n", SFPSTR(StrAppState(AppGlobal.State)),
 		ToString(curTS - AppGlobal.StageTS, TimeUnit::SEC, true).c_str());
+	{
+		uint32_t curMS = millis();
+		auto &Record = StageStats.Log[StageStats.Count++ % STAGE_LOG_DEPTH];
+		Record.State = AppGlobal.State;
+		Record.StartMS = StageStats.StageMS;
+		Record.SpanMS = curMS - StageStats.StageMS;
+		StageStats.StageMS = curMS;
+	}
 
 	time_t StartTS = AppGlobal.StartTS;
 	bool NoService = AppGlobal.NoService;
@@ -272,10 +766,175 @@ static time_t FinalizeCurrentState() {
 static void SwitchState(AppState state) {
 	AppGlobal.StageTS = FinalizeCurrentState();
 	AppGlobal.State = state;
+	{
+		// Only trace the first entry of each state
+		static uint8_t TracedStates = 0;
+		if (!(TracedStates & (1 << state))) {
+			TracedStates |= 1 << state;
+			switch (state) {
+				case APP_INIT: BootTrace_Mark(BOOTTRACE_INIT); break;
+				case APP_PORTAL: BootTrace_Mark(BOOTTRACE_PORTAL); break;
+				case APP_SERVICE: BootTrace_Mark(BOOTTRACE_SERVICE); break;
+				default: break;
+			}
+		}
+	}
+	EventLog_Append(EVENT_STATE, state);
 	ESPAPP_DEBUG("Start of state [%s] @%s\n", SFPSTR(StrAppState(AppGlobal.State)),
 		PrintTime(AppGlobal.StageTS).c_str());
 }
 
+// Boot trace record header: [magic:8][reset reason:8][sequence:16]
+static uint8_t BootTraceSlot;
+static uint16_t BootTraceSeq;
+
+static void BootTrace_Start(uint32_t reason) {
+	RTCMemory &RTCMem = RTCMemory::Manager();
+	// Reuse an empty record, or overwrite the oldest one
+	bool Unused = false, Valid = false;
+	uint16_t MinSeq = 0, MaxSeq = 0;
+	BootTraceSlot = 0;
+	for (uint8_t i = 0; i < BOOTTRACE_DEPTH; i++) {
+		uint32_t Header;
+		if (!RTCMem.Read(RTC_SLOT_BOOTTRACE + i * BOOTTRACE_RECORD_SLOTS, &Header, 1) ||
+			((Header >> 24) != BOOTTRACE_MAGIC)) {
+			if (!Unused) BootTraceSlot = i;
+			Unused = true;
+			continue;
+		}
+		uint16_t Seq = Header & 0xFFFF;
+		if (!Valid) {
+			MinSeq = MaxSeq = Seq;
+			Valid = true;
+			if (!Unused) BootTraceSlot = i;
+			continue;
+		}
+		if ((int16_t)(Seq - MaxSeq) > 0) MaxSeq = Seq;
+		if ((int16_t)(Seq - MinSeq) < 0) {
+			MinSeq = Seq;
+			if (!Unused) BootTraceSlot = i;
+		}
+	}
+	BootTraceSeq = MaxSeq + 1;
+
+	uint32_t Record[BOOTTRACE_RECORD_SLOTS];
+	memset(Record, 0, sizeof(Record));
+	Record[0] = (BOOTTRACE_MAGIC << 24) | ((reason & 0xFF) << 16) | BootTraceSeq;
+	if (!RTCMem.Write(RTC_SLOT_BOOTTRACE + BootTraceSlot * BOOTTRACE_RECORD_SLOTS,
+		Record, BOOTTRACE_RECORD_SLOTS)) {
+		ESPAPP_DEBUG("WARNING: Failed to start boot trace in RTC\n");
+	}
+}
+
+static void BootTrace_Mark(BootTracePoint point) {
+	uint32_t TS = micros();
+	RTCMemory &RTCMem = RTCMemory::Manager();
+	if (!RTCMem.Write(RTC_SLOT_BOOTTRACE + BootTraceSlot * BOOTTRACE_RECORD_SLOTS + 1 + point,
+		&TS, 1)) {
+		ESPAPP_DEBUG("WARNING: Failed to update boot trace to RTC\n");
+	}
+}
+
+// Event log ring in unsigned RTC memory, so that appending does not re-sign
+// the whole block. Each record checks itself, a torn write is simply dropped.
+// Record: [sequence:16][type:8][argument:8] [uptime:24][check:8]
+struct EventRecord {
+	uint16_t Seq;
+	uint8_t Type;
+	uint8_t Arg;
+	uint32_t MS;
+};
+
+static uint8_t EventLogHead;
+static uint16_t EventLogSeq;
+
+static uint8_t EventLog_Check(uint32_t word0, uint32_t word1) {
+	uint32_t Fold = word0 ^ (word1 >> 8);
+	Fold ^= Fold >> 16;
+	Fold ^= Fold >> 8;
+	return (Fold ^ EVENTLOG_MAGIC) & 0xFF;
+}
+
+static bool EventLog_Load(uint8_t index, EventRecord &record) {
+	uint32_t Record[EVENTLOG_RECORD_SLOTS];
+	if (!RTCMemory::Manager().ReadRaw(index * EVENTLOG_RECORD_SLOTS, Record,
+		EVENTLOG_RECORD_SLOTS)) return false;
+	if ((Record[1] & 0xFF) != EventLog_Check(Record[0], Record[1])) return false;
+	record.Seq = Record[0] >> 16;
+	record.Type = (Record[0] >> 8) & 0xFF;
+	record.Arg = Record[0] & 0xFF;
+	record.MS = (Record[1] >> 8) << EVENTLOG_TIME_SHIFT;
+	return record.Type != EVENT_NONE;
+}
+
+// Enumerate valid records from the oldest to the newest
+static void EventLog_Enum(std::function<void(EventRecord const &record)> const &callback) {
+	for (uint8_t i = 0; i < EVENTLOG_DEPTH; i++) {
+		EventRecord Record;
+		uint8_t Index = EventLogHead + i;
+		if (Index >= EVENTLOG_DEPTH) Index -= EVENTLOG_DEPTH;
+		if (EventLog_Load(Index, Record)) callback(Record);
+	}
+}
+
+// Locate the newest record, and continue after it
+static void EventLog_Start() {
+	bool Valid = false;
+	uint16_t MaxSeq = 0;
+	EventLogHead = 0;
+	for (uint8_t i = 0; i < EVENTLOG_DEPTH; i++) {
+		EventRecord Record;
+		if (!EventLog_Load(i, Record)) continue;
+		if (!Valid || ((int16_t)(Record.Seq - MaxSeq) > 0)) {
+			MaxSeq = Record.Seq;
+			EventLogHead = (i + 1 < EVENTLOG_DEPTH)? i + 1 : 0;
+			Valid = true;
+		}
+	}
+	EventLogSeq = MaxSeq + 1;
+}
+
+static void EventLog_Append(EventType type, uint8_t arg) {
+	// Event log compiled out
+	if (!EVENTLOG_DEPTH) return;
+	uint32_t Record[EVENTLOG_RECORD_SLOTS];
+	Record[0] = ((uint32_t)EventLogSeq << 16) | (type << 8) | arg;
+	Record[1] = (millis() >> EVENTLOG_TIME_SHIFT) << 8;
+	Record[1] |= EventLog_Check(Record[0], Record[1]);
+	if (!RTCMemory::Manager().WriteRaw(EventLogHead * EVENTLOG_RECORD_SLOTS, Record,
+		EVENTLOG_RECORD_SLOTS)) {
+		ESPAPP_DEBUG("WARNING: Failed to append event log to RTC\n");
+		return;
+	}
+	if (++EventLogHead >= EVENTLOG_DEPTH) EventLogHead = 0;
+	EventLogSeq++;
+}
+
+#define FSSTATS_REFRESH   60  // Seconds before cached file system usage is considered stale
+
+// File system usage is computed lazily, because it needs a full FAT scan;
+// a scan is only scheduled when the usage is requested and stale
+static struct {
+	bool Valid;
+	bool Refresh;
+	uint32_t UpdateMS;
+	FSInfo Info;
+} FSStats;
+
+static void FS_UpdateStats() {
+	FSStats.Refresh = false;
+	if (!VFATFS.info(FSStats.Info)) {
+		ESPAPP_DEBUG("WARNING: Failed to collect file system usage\n");
+		return;
+	}
+	FSStats.Valid = true;
+	FSStats.UpdateMS = millis();
+	ESPAPP_DEBUGV("FATFS: %s total, %s used (%.1f%%)\n",
+		ToString(FSStats.Info.totalBytes, SizeUnit::BYTE, true).c_str(),
+		ToString(FSStats.Info.usedBytes, SizeUnit::BYTE, true).c_str(),
+		FSStats.Info.usedBytes * 100.0 / FSStats.Info.totalBytes);
+}
+
 static Dir get_dir(String const &path) {
 	auto Ret = mkdirs(VFATFS, path);
 	if (!Ret) {
@@ -292,6 +951,7 @@ static void init_config_defaults() {
 	AppConfig.WiFi_Power = CONFIG_DEFAULT_WIFI_POWER;
 	AppConfig.WLAN_AP_Name.clear();
 	AppConfig.WLAN_AP_Pass.clear();
+	AppConfig.WLAN_AP_PMK.clear();
 	AppConfig.WLAN_WPS = true;
 	AppConfig.Init_Retry_Count = CONFIG_DEFAULT_INIT_RETRY_COUNT;
 	AppConfig.Init_Retry_Cycle = CONFIG_DEFAULT_INIT_RETRY_CYCLE;
@@ -371,6 +1031,23 @@ static WiFiSleepType load_config_powersaving(String const &spec, WiFiSleepType d
 	}
 }
 
+// Identifies the credential a pre-computed PMK was derived from
+static String wlan_pmk_tag() {
+	MD5Builder Hasher;
+	Hasher.begin();
+	Hasher.add(AppConfig.WLAN_AP_Name);
+	Hasher.add((uint8_t*)"", 1);
+	Hasher.add(AppConfig.WLAN_AP_Pass);
+	Hasher.calculate();
+	return Hasher.toString().substring(0, 8);
+}
+
+// Use pre-computed PMK to avoid PBKDF2 on every association
+static char const* wlan_passphrase() {
+	return AppConfig.WLAN_AP_PMK.empty()? AppConfig.WLAN_AP_Pass.c_str() :
+		AppConfig.WLAN_AP_PMK.c_str();
+}
+
 static void load_config_json(JsonObject const &obj) {
 	AppConfig.Production = obj[FPSTR(CONFIGKEY_Production)] | AppConfig.Production;
 	AppConfig.PersistWLAN = obj[FPSTR(CONFIGKEY_PersistWLAN)] | AppConfig.PersistWLAN;
@@ -385,6 +1062,14 @@ static void load_config_json(JsonObject const &obj) {
 
 	AppConfig.WLAN_AP_Name = obj[FPSTR(CONFIGKEY_WLAN_AP_Name)] | AppConfig.WLAN_AP_Name.c_str();
 	AppConfig.WLAN_AP_Pass = obj[FPSTR(CONFIGKEY_WLAN_AP_Pass)] | AppConfig.WLAN_AP_Pass.c_str();
+	{
+		// Only accept pre-computed key that matches current credential
+		String PMK = obj[FPSTR(CONFIGKEY_WLAN_AP_PMK)] | "";
+		String PMKTag = obj[FPSTR(CONFIGKEY_WLAN_AP_PMK_Tag)] | "";
+		if (PMK.length() == WPA_PMK_LEN * 2 && PMKTag == wlan_pmk_tag()) {
+			AppConfig.WLAN_AP_PMK = std::move(PMK);
+		} else AppConfig.WLAN_AP_PMK.clear();
+	}
 	AppConfig.WLAN_WPS = obj[FPSTR(CONFIGKEY_WLAN_WPS)] | AppConfig.WLAN_WPS;
 
 	AppConfig.Init_Retry_Count = obj[FPSTR(CONFIGKEY_Init_Retry_Count)] | AppConfig.Init_Retry_Count;
@@ -414,6 +1099,35 @@ static void load_config_json(JsonObject const &obj) {
 	} while (false);
 }
 
+// Content the in-memory parser cannot load is moved aside to a backup and the file
+// is emptied, so that loading continues with defaults; well-formed application files
+// that are only too large (or too deeply nested) are left for Appliance_StreamConfig()
+static bool config_malstor(Dir &dir, String const &filename, File &file) {
+	bool WellFormed = JsonStreamCheck(file);
+	if (WellFormed && !filename.equals(FL(APPLIANCE_CONFIG_FILE))) {
+		ESPAPP_LOG("WARNING: Configuration file '%s' too large to load (%s)\n",
+			filename.c_str(), ToString(file.size(), SizeUnit::BYTE, true).c_str());
+		return false;
+	}
+	ESPAPP_LOG("WARNING: Configuration file '%s' %s, moving aside...\n", filename.c_str(),
+		WellFormed? "too large to load" : "malformed");
+	String BackupName = filename + FL(CONFIG_BACKUP_EXT);
+	File Backup = dir.openFile(BackupName, "w");
+	if (Backup && file.seek(0, SeekSet)) {
+		uint8_t Buffer[JSON_STREAM_CHUNK];
+		int Len;
+		while ((Len = file.read(Buffer, sizeof(Buffer))) > 0) {
+			if (Backup.write(Buffer, Len) != (size_t)Len) {
+				ESPAPP_LOG("WARNING: Incomplete backup '%s'\n", BackupName.c_str());
+				break;
+			}
+		}
+	} else {
+		ESPAPP_LOG("WARNING: Unable to create backup '%s'\n", BackupName.c_str());
+	}
+	return file.truncate(0);
+}
+
 static JsonManagerResults load_config(String const &filename,
 	std::function<void(JsonObject const &obj)> const &load_cb) {
 	auto ConfigDir = get_dir(FL(CONFIG_DIR));
@@ -422,28 +1136,232 @@ static JsonManagerResults load_config(String const &filename,
 			load_cb(obj);
 			return false;
 		}, [&](File &file) {
-			return file.truncate(0);
+			return config_malstor(ConfigDir, filename, file);
 		});
 }
 
+static void ConfigCache_Sync(String const &filename, bool updated);
+
 static JsonManagerResults update_config(String const &filename,
 	JsonObjectCallback const &update_cb) {
+	ConfigCache_Sync(filename, false);
+	auto ConfigDir = get_dir(FL(CONFIG_DIR));
+	auto Ret = JsonManager(ConfigDir, filename, true, update_cb, [&](File &file) {
+		return config_malstor(ConfigDir, filename, file);
+	});
+	ConfigCache_Sync(filename, true);
+	return Ret;
+}
+
+// Compact serialization of recently used configuration files, so that repeated
+// access skips the file system; updates may be deferred and written back later.
+// Each access still parses the cached text into a scratch copy and a bounded
+// JSON buffer (up to JSON_MAXIMUM_PARSER_BUFFER), which is released afterwards.
+// The resident text is capped to CONFIG_CACHE_BYTES in total, a single larger
+// file is still cached alone.
+static struct ConfigCacheEntry {
+	String Name;
+	String Data;
+	uint32_t UseSeq;
+	bool Dirty;
+} ConfigCache[CONFIG_CACHE_SLOTS];
+static uint32_t ConfigCacheSeq;
+
+static ConfigCacheEntry* ConfigCache_Find(String const &filename) {
+	for (uint8_t i = 0; i < CONFIG_CACHE_SLOTS; i++) {
+		if (ConfigCache[i].Name && (ConfigCache[i].Name == filename)) {
+			ConfigCache[i].UseSeq = ++ConfigCacheSeq;
+			return &ConfigCache[i];
+		}
+	}
+	return nullptr;
+}
+
+static bool ConfigCache_Write(String const &filename, JsonObject const &obj) {
 	auto ConfigDir = get_dir(FL(CONFIG_DIR));
-	return JsonManager(ConfigDir, filename, true, update_cb, [&](File &file) {
-		return file.truncate(0);
+	String Data;
+	obj.prettyPrintTo(Data);
+	return JsonSaveFile(ConfigDir, filename, Data);
+}
+
+// Parse the cached data (in-place, on a scratch copy) and apply the callback
+static JsonManagerResults ConfigCache_Apply(ConfigCacheEntry &entry,
+	JsonObjectCallback const &obj_cb, bool deferred) {
+	String Work(entry.Data);
+	BoundedOneshotAllocator BoundedAllocator(JSON_MAXIMUM_PARSER_BUFFER);
+	BoundedDynamicJsonBuffer jsonBuffer(BoundedAllocator,
+		JSON_MAXIMUM_PARSER_BUFFER-BoundedDynamicJsonBuffer::EmptyBlockSize);
+	JsonObject &Obj = jsonBuffer.parseObject(Work.begin(), JSON_MAXIMUM_PARSER_NEST);
+	if (!Obj.success()) {
+		ESPAPP_DEBUG("WARNING: Error parsing cached config '%s'\n", entry.Name.c_str());
+		return JSONMAN_ERR_PARSER;
+	}
+	if (!obj_cb(Obj, jsonBuffer)) return JSONMAN_OK_READONLY;
+
+	String Data;
+	Obj.printTo(Data);
+	if (Data != entry.Data) {
+		entry.Data = std::move(Data);
+		entry.Dirty = true;
+	}
+	if (deferred || !entry.Dirty) return JSONMAN_OK_UPDATED;
+	if (!ConfigCache_Write(entry.Name, Obj)) {
+		ESPAPP_DEBUG("WARNING: Unable to write config '%s'\n", entry.Name.c_str());
+		return JSONMAN_WARN_UPDATEFAIL;
+	}
+	entry.Dirty = false;
+	return JSONMAN_OK_UPDATED;
+}
+
+static bool ConfigCache_Flush(ConfigCacheEntry &entry) {
+	if (!entry.Dirty) return true;
+	ESPAPP_DEBUGV("Writing back config '%s'...\n", entry.Name.c_str());
+	return ConfigCache_Apply(entry, [](JsonObject &obj, BoundedDynamicJsonBuffer &buf) {
+		return true;
+	}, false) == JSONMAN_OK_UPDATED;
+}
+
+static bool ConfigCache_FlushAll() {
+	bool Ret = true;
+	for (uint8_t i = 0; i < CONFIG_CACHE_SLOTS; i++) {
+		if (!ConfigCache_Flush(ConfigCache[i])) Ret = false;
+	}
+	return Ret;
+}
+
+static void ConfigCache_Drop(ConfigCacheEntry &entry) {
+	entry.Name.clear(true);
+	entry.Data.clear(true);
+	entry.Dirty = false;
+}
+
+static void ConfigCache_Clear() {
+	for (uint8_t i = 0; i < CONFIG_CACHE_SLOTS; i++)
+		ConfigCache_Drop(ConfigCache[i]);
+}
+
+// Direct file system writes (e.g. WebDAV) do not go through the cache,
+// forget everything once they have landed; the files on disk take precedence
+// over deferred updates, which are dropped without writing back
+static void ConfigCache_Invalidate() {
+	for (uint8_t i = 0; i < CONFIG_CACHE_SLOTS; i++) {
+		if (ConfigCache[i].Dirty) {
+			ESPAPP_DEBUG("WARNING: Deferred update to config '%s' discarded\n",
+				ConfigCache[i].Name.c_str());
+		}
+	}
+	ConfigCache_Clear();
+}
+
+// Keep the cache coherent with direct file access: write back pending updates
+// before the file is accessed, and forget the entry after it is modified
+static void ConfigCache_Sync(String const &filename, bool updated) {
+	auto Entry = ConfigCache_Find(filename);
+	if (!Entry) return;
+	if (!updated) {
+		ConfigCache_Flush(*Entry);
+		return;
+	}
+	ConfigCache_Drop(*Entry);
+}
+
+static size_t ConfigCache_Bytes() {
+	size_t Ret = 0;
+	for (uint8_t i = 0; i < CONFIG_CACHE_SLOTS; i++)
+		Ret += ConfigCache[i].Data.length();
+	return Ret;
+}
+
+static void ConfigCache_Evict(ConfigCacheEntry &entry) {
+	ESPAPP_DEBUGVV("Evicting cached config '%s'\n", entry.Name.c_str());
+	if (!ConfigCache_Flush(entry)) {
+		ESPAPP_DEBUG("WARNING: Deferred update to config '%s' lost\n", entry.Name.c_str());
+	}
+	ConfigCache_Drop(entry);
+}
+
+static ConfigCacheEntry* ConfigCache_LRU() {
+	ConfigCacheEntry* Ret = nullptr;
+	for (uint8_t i = 0; i < CONFIG_CACHE_SLOTS; i++) {
+		if (!ConfigCache[i].Name) continue;
+		if (!Ret || (ConfigCache[i].UseSeq < Ret->UseSeq)) Ret = &ConfigCache[i];
+	}
+	return Ret;
+}
+
+static ConfigCacheEntry* ConfigCache_Load(String const &filename, JsonManagerResults &result) {
+	auto Entry = ConfigCache_Find(filename);
+	if (Entry) return Entry;
+
+	String Data;
+	result = load_config(filename, [&](JsonObject const &obj) {
+		obj.printTo(Data);
 	});
+	if (result >= JSONMAN_WARN) return nullptr;
+
+	// Evict least recently used entries to stay within the heap budget
+	while (ConfigCache_Bytes() &&
+		(ConfigCache_Bytes() + Data.length() > CONFIG_CACHE_BYTES)) {
+		ConfigCache_Evict(*ConfigCache_LRU());
+	}
+	// Take an empty slot, or evict the least recently used one
+	Entry = nullptr;
+	for (uint8_t i = 0; i < CONFIG_CACHE_SLOTS; i++) {
+		if (!ConfigCache[i].Name) {
+			Entry = &ConfigCache[i];
+			break;
+		}
+	}
+	if (!Entry) {
+		Entry = ConfigCache_LRU();
+		ConfigCache_Evict(*Entry);
+	}
+	Entry->Name = filename;
+	Entry->Data = std::move(Data);
+	Entry->UseSeq = ++ConfigCacheSeq;
+	Entry->Dirty = false;
+	return Entry;
 }
 
+// Wall clock second paired with the RTC counter value at that second,
+// the calibrated RTC clock period (microseconds, Q12 fixed point),
+// and a periodically saved coarse wall clock second
+struct ClockAnchor {
+	uint32_t Wall;
+	uint32_t Ticks;
+	uint32_t Cali;
+	uint32_t Coarse;
+};
+
+#define RTC_SLOT_CLOCKCOARSE    (RTC_SLOT_CLOCKANCHOR + offsetof(ClockAnchor, Coarse) / 4)
+
+static void updateRTCClock();
+
 static void InitBootTime(RTCMemory &RTCMem) {
 	time_t baseTime;
 	if (RTCFlags & RTC_FLAG_TIMESYNC) {
-		if (RTCMem.Read(RTC_SLOT_LASTKNOWNTS, (uint32_t*)&baseTime, 1)) {
-			// Restore SNTP clock, not exactly accurate, but good enough
-			struct timeval tv = { baseTime, 0 };
+		ClockAnchor Anchor;
+		if (RTCMem.Read(RTC_SLOT_CLOCKANCHOR, (uint32_t*)&Anchor, RTC_CLOCKANCHOR_SLOTS) &&
+			Anchor.Cali) {
+			struct timeval tv = { (time_t)Anchor.Wall, 0 };
+			// RTC counter keeps running across software and watchdog resets,
+			// but restarts from zero on external reset
+			uint32_t Elapsed = system_get_rtc_time() - Anchor.Ticks;
+			if ((resetInfo.reason != REASON_EXT_SYS_RST) && ((int32_t)Elapsed >= 0)) {
+				uint64_t ElapsedUS = ((uint64_t)Elapsed * Anchor.Cali) >> 12;
+				tv.tv_sec += ElapsedUS / 1000000;
+				tv.tv_usec = ElapsedUS % 1000000;
+				settimeofday(&tv, nullptr);
+				return;
+			}
+			ESPAPP_DEBUG("WARNING: RTC counter discontinued, clock restored to last saved second\n");
+			if ((int32_t)(Anchor.Coarse - Anchor.Wall) > 0) tv.tv_sec = Anchor.Coarse;
 			settimeofday(&tv, nullptr);
+			// The stored counter value is meaningless from now on
+			updateRTCClock();
 			return;
 		}
-		ESPAPP_DEBUG("WARNING: Error loading last known time from RTC\n");
+		ESPAPP_DEBUG("WARNING: Error loading clock anchor from RTC\n");
 		RTCFlags &= ~RTC_FLAG_TIMESYNC;
 	}
 	struct tm BootTM;
@@ -476,28 +1394,194 @@ static void WiFiEvent_Disconnected(const WiFiEventStationModeDisconnected& evt);
 
 WiFiEventHandler onConnected, onReceivedIP, onDisconnected;
 
-void setup() {
-	Serial.begin(115200);
-	delay(100);
-	Serial.println();
-	Serial.println(FL("ESP8266 ZWAppliance Core v" ZWAPP_VERSION));
+static void init_wifi_events() {
+	onConnected = WiFi.onStationModeConnected(WiFiEvent_Connected);
+	onReceivedIP = WiFi.onStationModeGotIP(WiFiEvent_ReceivedIP);
+	onDisconnected = WiFi.onStationModeDisconnected(WiFiEvent_Disconnected);
+}
 
-	// Initialize/check RTC memory
-	RTCMemory &RTCMem = RTCMemory::Manager();
-	if (!RTCMem.Read(RTC_SLOT_FLAGS, &RTCFlags, 1)) {
-		ESPAPP_LOG("WARNING: Failed to load appliance flags from RTC\n");
-		RTCFlags = 0;
+static void init_wifi() {
+	ESPAPP_DEBUG("Initializing WiFi...\n");
+	if (!AppConfig.PersistWLAN) {
+		if (WiFi.getMode() != WIFI_OFF) {
+			if (!WiFi.mode(WIFI_OFF)) {
+				ESPAPP_LOG("WARNING: Failed to disable WiFi!\n");
+			}
+		}
+		// Order is important
+		WiFi.persistent(false);
 	}
-
-	ESPAPP_DEBUGV("Marking appliance flags in RTC...\n");
-	uint32_t BootRTCFlags = RTCFlags | RTC_FLAG_RESTORED | RTC_FLAG_BOOTFAIL;
-	if (!RTCMem.Write(RTC_SLOT_FLAGS, &BootRTCFlags, 1)) {
-		ESPAPP_DEBUG("WARNING: Failed to update appliance flags to RTC\n");
+	if (!WiFi.getAutoConnect()) {
+		WiFi.setAutoConnect(true);
+	}
+	if (!WiFi.getAutoReconnect()) {
+		WiFi.setAutoReconnect(true);
 	}
 
-	// Set a reasonable start time
-	InitBootTime(RTCMem);
-
+	if (WiFi.getSleepMode() != AppConfig.PowerSaving) {
+		if (!WiFi.setSleepMode(AppConfig.PowerSaving)) {
+			ESPAPP_LOG("WARNING: Failed to configure energy saving!\n");
+		}
+	}
+#ifdef SDKBUG_LIGHTSLEEP_POLL
+	if (WiFi.getSleepMode() == WIFI_LIGHT_SLEEP) {
+		ESPAPP_DEBUG("Enabling supplemental LWIP timer...\n");
+		LWIPTimer.attach(1, LWIP_TIMER_POLL);
+	} else LWIPTimer.detach();
+#endif
+	if (WiFi.getPhyMode() != WIFI_PHY_MODE_11N) {
+		if (!WiFi.setPhyMode(WIFI_PHY_MODE_11N)) {
+			ESPAPP_LOG("WARNING: Failed to configure WiFi in 802.11n mode!\n");
+		}
+	}
+	WiFi.setOutputPower(AppConfig.WiFi_Power);
+	init_wifi_events();
+
+	if (!WiFi.mode(WIFI_STA)) {
+		ESPAPP_LOG("ERROR: Failed to enable WiFi client mode!\n");
+		panic();
+	}
+	auto hostname = WiFi.hostname();
+	if (hostname != AppConfig.Hostname) {
+		WiFi.hostname(AppConfig.Hostname.c_str());
+	}
+}
+
+// Compact copy of the WiFi related configurations, cached in RTC memory
+// so that warm boots can bring up WiFi before the file system
+struct ConfigSnapshot {
+	uint8_t Hash[MD5_BINLEN];
+	uint8_t Magic;
+	uint8_t PersistWLAN;
+	uint8_t PowerSaving;
+	uint8_t WiFi_Power;
+	char Hostname[CFGSNAPSHOT_HOSTNAME_LEN];
+};
+
+static_assert(sizeof(ConfigSnapshot) == RTC_CFGSNAPSHOT_SLOTS * 4,
+	"Configuration snapshot does not match its RTC slot allocation");
+
+static bool load_config_snapshot(RTCMemory &RTCMem, ConfigSnapshot &Snapshot) {
+	if (!RTCMem.Read(RTC_SLOT_CFGSNAPSHOT, (uint32_t*)&Snapshot, RTC_CFGSNAPSHOT_SLOTS)) {
+		ESPAPP_DEBUG("WARNING: Failed to load configuration snapshot from RTC\n");
+		return false;
+	}
+	if (Snapshot.Magic != CFGSNAPSHOT_MAGIC) return false;
+	if (Snapshot.Hostname[CFGSNAPSHOT_HOSTNAME_LEN - 1]) return false;
+
+	AppConfig.PersistWLAN = Snapshot.PersistWLAN;
+	AppConfig.PowerSaving = (WiFiSleepType)Snapshot.PowerSaving;
+	AppConfig.WiFi_Power = Snapshot.WiFi_Power / 4.0;
+	AppConfig.Hostname = Snapshot.Hostname;
+	return true;
+}
+
+static void save_config_snapshot(RTCMemory &RTCMem, uint8_t const *Hash) {
+	ConfigSnapshot Snapshot;
+	memset(&Snapshot, 0, sizeof(ConfigSnapshot));
+	if (AppConfig.Hostname.length() < CFGSNAPSHOT_HOSTNAME_LEN) {
+		memcpy(Snapshot.Hash, Hash, MD5_BINLEN);
+		Snapshot.Magic = CFGSNAPSHOT_MAGIC;
+		Snapshot.PersistWLAN = AppConfig.PersistWLAN;
+		Snapshot.PowerSaving = AppConfig.PowerSaving;
+		Snapshot.WiFi_Power = AppConfig.WiFi_Power * 4;
+		memcpy(Snapshot.Hostname, AppConfig.Hostname.c_str(), AppConfig.Hostname.length());
+	} else {
+		ESPAPP_DEBUGV("Hostname too long for configuration snapshot\n");
+	}
+	if (!RTCMem.Write(RTC_SLOT_CFGSNAPSHOT, (uint32_t*)&Snapshot, RTC_CFGSNAPSHOT_SLOTS)) {
+		ESPAPP_DEBUG("WARNING: Failed to update configuration snapshot to RTC\n");
+	}
+}
+
+static bool hash_config_file(uint8_t *Hash) {
+	auto ConfigDir = get_dir(FL(CONFIG_DIR));
+	if (!HashFile(ConfigDir, FL(APPLIANCE_CONFIG_FILE), Hash)) {
+		ESPAPP_DEBUG("WARNING: Failed to hash appliance configuration file\n");
+		return false;
+	}
+	return true;
+}
+
+static void ConfigSnapshotJob_Save(uint32_t) {
+	uint8_t ConfigHash[MD5_BINLEN];
+	if (!hash_config_file(ConfigHash)) return;
+	save_config_snapshot(RTCMemory::Manager(), ConfigHash);
+}
+
+#ifdef WLAN_EARLY_ASSOCIATION
+static bool EarlyAssociation = false;
+static struct station_config EarlyStationConfig;
+
+static void Init_EarlyAssociate() {
+	if (!wifi_station_get_config_default(&EarlyStationConfig)) return;
+	if (!EarlyStationConfig.ssid[0]) return;
+
+	ESPAPP_DEBUG("Associating with stored WiFi access point...\n");
+	if (WiFi.status() != WL_CONNECTED) {
+		if (!wifi_station_connect()) {
+			ESPAPP_DEBUG("WARNING: Failed to start early association\n");
+			return;
+		}
+	}
+	EarlyAssociation = true;
+}
+
+static void Init_EarlyReconcile() {
+	if (!EarlyAssociation) return;
+	if (AppConfig.PersistWLAN &&
+		!strncmp((char const*)EarlyStationConfig.ssid, AppConfig.WLAN_AP_Name.c_str(),
+			sizeof(EarlyStationConfig.ssid)) &&
+		!strncmp((char const*)EarlyStationConfig.password, wlan_passphrase(),
+			sizeof(EarlyStationConfig.password))) return;
+
+	ESPAPP_DEBUG("Stored WiFi credential does not match configuration, aborting early association\n");
+	EarlyAssociation = false;
+	wifi_station_disconnect();
+}
+#endif
+
+void setup() {
+	Serial.begin(115200);
+	delay(100);
+	Serial.println();
+	Serial.println(FL("ESP8266 ZWAppliance Core v" ZWAPP_VERSION));
+
+	// Initialize/check RTC memory
+	RTCMemory &RTCMem = RTCMemory::Manager();
+	if (!RTCMem.Attach(0, RTC_SLOTS_RESERVED, RTCCoreRegions, RTCREGION_COUNT)) {
+		ESPAPP_LOG("WARNING: Failed to lay out core RTC memory regions\n");
+	}
+	if (!RTCMem.Read(RTC_SLOT_FLAGS, &RTCFlags, 1)) {
+		ESPAPP_LOG("WARNING: Failed to load appliance flags from RTC\n");
+		RTCFlags = 0;
+	}
+
+	ESPAPP_DEBUGV("Marking appliance flags in RTC...\n");
+	uint32_t BootRTCFlags = RTCFlags | RTC_FLAG_RESTORED | RTC_FLAG_BOOTFAIL;
+	if (!RTCMem.Write(RTC_SLOT_FLAGS, &BootRTCFlags, 1)) {
+		ESPAPP_DEBUG("WARNING: Failed to update appliance flags to RTC\n");
+	}
+
+	// Core setup phases share one RTC flush, the appliance flags above are not deferred
+	RTCMem.Begin();
+	BootTrace_Start(resetInfo.reason);
+	BootTrace_Mark(BOOTTRACE_RTC);
+
+	EventLog_Start();
+	ESPAPP_DEBUGDO(
+		ESPAPP_LOG("Event log before reset:\n");
+		EventLog_Enum([](EventRecord const &record) {
+			ESPAPP_LOG("- #%d @%ums: %s (%d)\n", record.Seq, record.MS,
+				SFPSTR(StrEventType((EventType)record.Type)), record.Arg);
+		});
+	);
+	EventLog_Append(EVENT_BOOT, resetInfo.reason);
+
+	// Set a reasonable start time
+	InitBootTime(RTCMem);
+	BootTrace_Mark(BOOTTRACE_CLOCK);
+
 	// Initialize global states
 	memset(&AppGlobal, 0, sizeof(AppGlobal));
 	//AppGlobal.State = APP_STARTUP;
@@ -513,6 +1597,31 @@ void setup() {
 	APConnected = false;
 	APLastDisconnectReason = WIFI_DISCONNECT_REASON_UNSPECIFIED;
 
+	// Bring up WiFi early if a configuration snapshot is available
+	ConfigSnapshot Snapshot;
+	bool WiFiSnapshot = false;
+	if (RTCFlags & RTC_FLAG_RESTORED) {
+		init_config_defaults();
+		if (load_config_snapshot(RTCMem, Snapshot)) {
+			ESPAPP_DEBUG("Applying configuration snapshot...\n");
+			init_wifi();
+			WiFiSnapshot = true;
+			BootTrace_Mark(BOOTTRACE_WIFI);
+#ifdef WLAN_EARLY_ASSOCIATION
+			// File system and configuration load overlap with association
+			if (AppConfig.PersistWLAN) Init_EarlyAssociate();
+#endif
+		}
+	}
+#ifdef WLAN_EARLY_ASSOCIATION
+	// Without a snapshot (e.g. cold boots), rely on the station mode and
+	// credential the SDK keeps in flash; reconciled once configuration is loaded
+	if (!WiFiSnapshot && (wifi_get_opmode() & STATION_MODE)) {
+		init_wifi_events();
+		Init_EarlyAssociate();
+	}
+#endif
+
 	// Base on boot reason, decide whether we should bypass service
 	ESPAPP_DEBUG("Boot reason: %s\n",
 		SFPSTR(resetReasonToStr(resetInfo.reason)));
@@ -523,13 +1632,16 @@ void setup() {
 	if (!VFATFS.begin()) {
 		ESPAPP_DEBUG("ERROR: Failed to start file system!\n");
 		panic();
-	} else {
-		FSInfo info;
-		VFATFS.info(info);
-		ESPAPP_LOG("FATFS: %s total, %s used (%.1f%%)\n",
-			ToString(info.totalBytes, SizeUnit::BYTE, true).c_str(),
-			ToString(info.usedBytes, SizeUnit::BYTE, true).c_str(),
-			info.usedBytes * 100.0 / info.totalBytes);
+	}
+	BootTrace_Mark(BOOTTRACE_FS);
+
+	// Validate the snapshot against the file before loading may rewrite it
+	uint8_t ConfigHash[MD5_BINLEN];
+	if (WiFiSnapshot) {
+		if (!hash_config_file(ConfigHash) || memcmp(ConfigHash, Snapshot.Hash, MD5_BINLEN)) {
+			ESPAPP_DEBUG("Configuration snapshot outdated, re-initializing...\n");
+			WiFiSnapshot = false;
+		}
 	}
 
 	ESPAPP_DEBUG("Loading Configurations...\n");
@@ -538,54 +1650,19 @@ void setup() {
 		ESPAPP_LOG("ERROR: Error loading appliance configuration file\n");
 		panic();
 	}
-
-	ESPAPP_DEBUG("Initializing WiFi...\n");
-	if (!AppConfig.PersistWLAN) {
-		if (WiFi.getMode() != WIFI_OFF) {
-			if (!WiFi.mode(WIFI_OFF)) {
-				ESPAPP_LOG("WARNING: Failed to disable WiFi!\n");
-			}
+	BootTrace_Mark(BOOTTRACE_CONFIG);
+
+	if (!WiFiSnapshot) {
+		init_wifi();
+		BootTrace_Mark(BOOTTRACE_WIFI);
+		// Hashing is deferred out of setup(), the snapshot is only needed by the next boot
+		if (!Work_Post(ConfigSnapshotJob_Save, 0)) {
+			ESPAPP_DEBUG("WARNING: Failed to schedule configuration snapshot\n");
 		}
-		// Order is important
-		WiFi.persistent(false);
-	}
-	if (!WiFi.getAutoConnect()) {
-		WiFi.setAutoConnect(true);
-	}
-	if (!WiFi.getAutoReconnect()) {
-		WiFi.setAutoReconnect(true);
-	}
-
-	if (WiFi.getSleepMode() != AppConfig.PowerSaving) {
-		if (!WiFi.setSleepMode(AppConfig.PowerSaving)) {
-			ESPAPP_LOG("WARNING: Failed to configure energy saving!\n");
-		}
-	}
-#ifdef SDKBUG_LIGHTSLEEP_POLL
-	if (WiFi.getSleepMode() == WIFI_LIGHT_SLEEP) {
-		ESPAPP_DEBUG("Enabling supplemental LWIP timer...\n");
-		LWIPTimer.attach(1, LWIP_TIMER_POLL);
 	}
+#ifdef WLAN_EARLY_ASSOCIATION
+	Init_EarlyReconcile();
 #endif
-	if (WiFi.getPhyMode() != WIFI_PHY_MODE_11N) {
-		if (!WiFi.setPhyMode(WIFI_PHY_MODE_11N)) {
-			ESPAPP_LOG("WARNING: Failed to configure WiFi in 802.11n mode!\n");
-		}
-	}
-	WiFi.setOutputPower(AppConfig.WiFi_Power);
-
-	onConnected = WiFi.onStationModeConnected(WiFiEvent_Connected);
-	onReceivedIP = WiFi.onStationModeGotIP(WiFiEvent_ReceivedIP);
-	onDisconnected = WiFi.onStationModeDisconnected(WiFiEvent_Disconnected);
-
-	if (!WiFi.mode(WIFI_STA)) {
-		ESPAPP_LOG("ERROR: Failed to enable WiFi client mode!\n");
-		panic();
-	}
-	auto hostname = WiFi.hostname();
-	if (hostname != AppConfig.Hostname) {
-		WiFi.hostname(AppConfig.Hostname.c_str());
-	}
 
 	if ((resetInfo.reason == 1) ||	// Hard WDT
 		(resetInfo.reason == 2) ||	// Fatal Exception
@@ -604,36 +1681,214 @@ void setup() {
 		} while(false);
 	}
 
+	if (!RTCMem.Commit()) {
+		ESPAPP_DEBUG("WARNING: Failed to flush setup states to RTC\n");
+	}
+
 	if (!AppGlobal.NoService)
 		__userapp_setup();
+	BootTrace_Mark(BOOTTRACE_SETUP);
+
+	StageStats.SetupMS = millis();
+	ESPAPP_DEBUGV("Setup completed in %u ms\n", StageStats.SetupMS);
+}
+
+static void WiFiJob_Connected(uint32_t) {
+	APLastDisconnectReason = WIFI_DISCONNECT_REASON_UNSPECIFIED;
 }
 
 static void WiFiEvent_Connected(const WiFiEventStationModeConnected& evt) {
 	ESPAPP_DEBUGVV("- WiFi connected!\n");
-	APLastDisconnectReason = WIFI_DISCONNECT_REASON_UNSPECIFIED;
 	APConnected = APReceivedIP;
 	memcpy(APMAC, evt.bssid, 6);
 	APCHAN = evt.channel;
+	// Keep ordering with pending disconnection jobs
+	if (!Work_Post(WiFiJob_Connected, 0, true)) {
+		// Ordering is already lost with a flooded queue, do not lose the connection too
+		ESPAPP_DEBUGV("WARNING: Work queue full, connection processed out of order\n");
+		WiFiJob_Connected(0);
+	}
 }
 
 static void WiFiEvent_ReceivedIP(const WiFiEventStationModeGotIP& evt) {
 	ESPAPP_DEBUGVV("- WiFi obtained IP!\n");
 	APConnected = APReceivedIP = true;
-}
 
-static void WiFiEvent_Disconnected(const WiFiEventStationModeDisconnected& evt) {
-	ESPAPP_DEBUGVV("WiFi disconnection (reason %d)\n", evt.reason);
-	APConnected = false;
+	uint32_t curMS = millis();
+	if (!WLANStats.OnlineMS) WLANStats.OnlineMS = curMS;
+	if (WLANStats.DownMS) {
+		uint32_t DownSpan = curMS - WLANStats.DownMS;
+		WLANStats.DownMS = 0;
+		WLANStats.Reconnects++;
+		WLANStats.ReconnectTotalMS += DownSpan;
+		if (DownSpan > WLANStats.ReconnectMaxMS)
+			WLANStats.ReconnectMaxMS = DownSpan;
+	}
+	Loop_Wakeup();
+}
 
+static void WiFiJob_Disconnected(uint32_t arg) {
+	WiFiDisconnectReason Reason = (WiFiDisconnectReason)arg;
 	if ((AppGlobal.State == APP_INIT) && (AppGlobal.init.steps == INIT_STA_CONNECT)) {
-		switch (evt.reason) {
+		if (AppGlobal.init.fastConnect) {
+			switch (Reason) {
+				// Pinned access point gone or refusing association
+				case WIFI_DISCONNECT_REASON_NO_AP_FOUND:
+				case WIFI_DISCONNECT_REASON_ASSOC_EXPIRE:
+				case WIFI_DISCONNECT_REASON_ASSOC_TOOMANY:
+				case WIFI_DISCONNECT_REASON_ASSOC_FAIL:
+				case WIFI_DISCONNECT_REASON_BEACON_TIMEOUT:
+					AppGlobal.init.fastFailure = true;
+			}
+		}
+		switch (Reason) {
 			case WIFI_DISCONNECT_REASON_AUTH_EXPIRE:
 			case WIFI_DISCONNECT_REASON_AUTH_FAIL:
 				// Need two repeated code to confirm
-				if (APLastDisconnectReason != evt.reason) break;
+				if (APLastDisconnectReason != Reason) break;
 				AppGlobal.init.authFailure = true;
 		}
-		APLastDisconnectReason = evt.reason;
+		APLastDisconnectReason = Reason;
+	}
+}
+
+static void WiFiEvent_Disconnected(const WiFiEventStationModeDisconnected& evt) {
+	ESPAPP_DEBUGVV("WiFi disconnection (reason %d)\n", evt.reason);
+	if (WLANStats.Leaving) {
+		WLANStats.Leaving = false;
+	} else {
+		if (APConnected) {
+			WLANStats.Disconnects++;
+			WLANStats.DownMS = millis();
+		}
+		WLANStats.Reasons[WLANStats.ReasonCount++ % WLAN_REASON_DEPTH] = evt.reason;
+	}
+	APConnected = false;
+	EventLog_Append(EVENT_WLAN_DISCONNECT, evt.reason);
+	if (!Work_Post(WiFiJob_Disconnected, evt.reason, true)) {
+		ESPAPP_DEBUGV("WARNING: Work queue full, disconnection not processed\n");
+	}
+}
+
+// Association and addressing of the last successful connection,
+// cached in RTC memory to skip scanning and DHCP on the next boot
+struct WLANLease {
+	uint8_t BSSID[6];
+	uint8_t Channel;
+	uint8_t Reuse;
+	uint32_t SSIDHash;
+	uint32_t IP;
+	uint32_t Gateway;
+	uint32_t Netmask;
+	uint32_t DNS;
+};
+
+static_assert(sizeof(WLANLease) == RTC_WLANLEASE_SLOTS * 4,
+	"WLAN lease does not match its RTC slot allocation");
+
+static uint32_t hash_ssid(String const &SSID) {
+	uint8_t sig[MD5_BINLEN];
+	calcMD5(SSID.c_str(), SSID.length(), sig);
+	uint32_t Ret;
+	memcpy(&Ret, sig, sizeof(Ret));
+	return Ret;
+}
+
+static bool load_wlan_lease(WLANLease &Lease) {
+	RTCMemory &RTCMem = RTCMemory::Manager();
+	if (!RTCMem.Read(RTC_SLOT_WLANLEASE, (uint32_t*)&Lease, RTC_WLANLEASE_SLOTS)) {
+		ESPAPP_DEBUG("WARNING: Failed to load WLAN lease from RTC\n");
+		return false;
+	}
+	if (!Lease.IP || !Lease.Channel) return false;
+	if (Lease.SSIDHash != hash_ssid(AppConfig.WLAN_AP_Name)) return false;
+	if (Lease.Reuse >= WLAN_LEASE_REUSE_MAX) {
+		ESPAPP_DEBUGV("Cached WLAN lease reused too many times, renewing...\n");
+		return false;
+	}
+	return true;
+}
+
+static void save_wlan_lease(uint8_t Reuse) {
+	WLANLease Lease;
+	memcpy(Lease.BSSID, APMAC, 6);
+	Lease.Channel = APCHAN;
+	Lease.Reuse = Reuse;
+	Lease.SSIDHash = hash_ssid(AppConfig.WLAN_AP_Name);
+	Lease.IP = WiFi.localIP();
+	Lease.Gateway = WiFi.gatewayIP();
+	Lease.Netmask = WiFi.subnetMask();
+	Lease.DNS = WiFi.dnsIP();
+	RTCMemory &RTCMem = RTCMemory::Manager();
+	if (!RTCMem.Write(RTC_SLOT_WLANLEASE, (uint32_t*)&Lease, RTC_WLANLEASE_SLOTS)) {
+		ESPAPP_DEBUG("WARNING: Failed to update WLAN lease to RTC\n");
+	}
+}
+
+static void clear_wlan_lease() {
+	WLANLease Lease;
+	memset(&Lease, 0, sizeof(WLANLease));
+	RTCMemory &RTCMem = RTCMemory::Manager();
+	if (!RTCMem.Write(RTC_SLOT_WLANLEASE, (uint32_t*)&Lease, RTC_WLANLEASE_SLOTS)) {
+		ESPAPP_DEBUG("WARNING: Failed to update WLAN lease to RTC\n");
+	}
+}
+
+static uint8_t WLANLeaseRenewal = WHEEL_TIMER_NONE;
+static uint8_t WLANLeaseWait;
+static uint32_t WLANLeaseIP;
+
+static void WLANLease_CheckRenewal() {
+	struct netif *Intf = netif_default;
+	bool Bound = Intf && dhcp_supplied_address(Intf);
+	if (!Bound && (++WLANLeaseWait < WLAN_LEASE_RENEW_TIMEOUT)) return;
+
+	Wheel_Stop(WLANLeaseRenewal);
+	WLANLeaseRenewal = WHEEL_TIMER_NONE;
+	if (!Bound) {
+		ESPAPP_DEBUG("WARNING: Cached WLAN lease not confirmed by DHCP, discarding...\n");
+		clear_wlan_lease();
+		return;
+	}
+	if ((uint32_t)WiFi.localIP() != WLANLeaseIP) {
+		ESPAPP_LOG("WARNING: Cached WLAN lease rejected, DHCP assigned %s\n",
+			WiFi.localIP().toString().c_str());
+	} else ESPAPP_DEBUGV("Cached WLAN lease confirmed by DHCP\n");
+	save_wlan_lease(0);
+}
+
+// Hand the station interface back to DHCP after a fast reconnect.
+// The cached address stays in use until the server confirms or replaces it.
+static void WLANLease_Renew() {
+	WLANLeaseIP = WiFi.localIP();
+	WLANLeaseWait = 0;
+	WiFi.config(IPAddress(), IPAddress(), IPAddress());
+	if (WLANLeaseRenewal == WHEEL_TIMER_NONE)
+		WLANLeaseRenewal = Wheel_Start(1000, WLANLease_CheckRenewal, true);
+}
+
+static void Init_Connect(WLANLease const *Lease) {
+	wl_status_t Status;
+	if (Lease) {
+		ESPAPP_DEBUGV("Using cached WLAN lease (%s @CH%d, IP %s)\n",
+			PrintMAC(Lease->BSSID).c_str(), Lease->Channel,
+			IPAddress(Lease->IP).toString().c_str());
+		WiFi.config(IPAddress(Lease->IP), IPAddress(Lease->Gateway),
+			IPAddress(Lease->Netmask), IPAddress(Lease->DNS));
+		// Keep the BSSID pin out of the SDK flash config, it must not outlive this boot
+		WiFi.persistent(false);
+		Status = WiFi.begin(AppConfig.WLAN_AP_Name.c_str(), wlan_passphrase(),
+			Lease->Channel, Lease->BSSID, false);
+		if (AppConfig.PersistWLAN) WiFi.persistent(true);
+	} else {
+		Status = WiFi.begin(AppConfig.WLAN_AP_Name.c_str(), wlan_passphrase(),
+			0, nullptr, false);
+	}
+	if (Status != WL_CONNECTED) {
+		ESPAPP_LOG("Connecting to WiFi access point '%s'...\n",
+			AppConfig.WLAN_AP_Name.c_str());
+		if (Lease || !AppConfig.PersistWLAN) WiFi.reconnect();
+		delay(100);
 	}
 }
 
@@ -646,14 +1901,30 @@ static void Init_Start() {
 	AppGlobal.init.cycleTS = AppGlobal.init.lastKnownTS = GetCurrentTS();
 	//AppGlobal.init.authFailure = false;
 
-	auto Status = WiFi.begin(AppConfig.WLAN_AP_Name.c_str(), AppConfig.WLAN_AP_Pass.c_str(),
-		0, nullptr, false);
-	if (Status != WL_CONNECTED) {
+#ifdef WLAN_EARLY_ASSOCIATION
+	if (EarlyAssociation) {
+		// Association already in progress since setup
+		EarlyAssociation = false;
 		ESPAPP_LOG("Connecting to WiFi access point '%s'...\n",
 			AppConfig.WLAN_AP_Name.c_str());
-		if (!AppConfig.PersistWLAN) WiFi.reconnect();
-		delay(100);
+		return;
 	}
+#endif
+
+	WLANLease Lease;
+	AppGlobal.init.fastConnect = load_wlan_lease(Lease);
+	Init_Connect(AppGlobal.init.fastConnect? &Lease : nullptr);
+}
+
+static void Init_FastConnectFallback() {
+	ESPAPP_DEBUG("Fast reconnect failed, falling back to full connection...\n");
+	clear_wlan_lease();
+	AppGlobal.init.fastConnect = false;
+	AppGlobal.init.fastFailure = false;
+	AppGlobal.init.cycleTS = GetCurrentTS();
+	// Revert to DHCP
+	WiFi.config(IPAddress(), IPAddress(), IPAddress());
+	Init_Connect(nullptr);
 }
 
 static void Portal_Start();
@@ -679,9 +1950,18 @@ static void Init_TimeoutTrigger() {
 }
 
 static void updateRTCClock() {
-	time_t curTS = GetCurrentTS();
+	struct timeval tv;
+	gettimeofday(&tv, nullptr);
+	uint32_t Ticks = system_get_rtc_time();
+	ClockAnchor Anchor;
+	Anchor.Cali = system_rtc_clock_cali_proc();
+	Anchor.Wall = Anchor.Coarse = tv.tv_sec;
+	// Align the counter to the start of the current second
+	Anchor.Ticks = Ticks - (uint32_t)(((uint64_t)tv.tv_usec << 12) / Anchor.Cali);
+
 	RTCMemory &RTCMem = RTCMemory::Manager();
-	if (RTCMem.Write(RTC_SLOT_LASTKNOWNTS, (uint32_t*)&curTS, 1)) {
+	RTCMem.Begin();
+	if (RTCMem.Write(RTC_SLOT_CLOCKANCHOR, (uint32_t*)&Anchor, RTC_CLOCKANCHOR_SLOTS)) {
 		if (!(RTCFlags & RTC_FLAG_TIMESYNC)) {
 			RTCFlags |= RTC_FLAG_TIMESYNC;
 			if (!RTCMem.Write(RTC_SLOT_FLAGS, &RTCFlags, 1)) {
@@ -689,11 +1969,23 @@ static void updateRTCClock() {
 			}
 		}
 	} else {
-		ESPAPP_DEBUG("WARNING: Failed to update last known time to RTC\n");
+		ESPAPP_DEBUG("WARNING: Failed to update clock anchor to RTC\n");
+	}
+	if (!RTCMem.Commit()) {
+		ESPAPP_DEBUG("WARNING: Failed to commit clock update to RTC\n");
 	}
 }
 
-static void WPS_Finished(wps_cb_status status) {
+// Cheap single slot save, bounds the clock regression after an external reset
+static void updateRTCClockCoarse() {
+	uint32_t Coarse = GetCurrentTS();
+	if (!RTCMemory::Manager().Write(RTC_SLOT_CLOCKCOARSE, &Coarse, 1)) {
+		ESPAPP_DEBUG("WARNING: Failed to update coarse clock to RTC\n");
+	}
+}
+
+static void WPSJob_Finished(uint32_t arg) {
+	wps_cb_status status = (wps_cb_status)arg;
 	if(!wifi_wps_disable()) {
 		ESPAPP_DEBUG("WARNING: Error leaving WPS mode!\n");
 	}
@@ -725,6 +2017,14 @@ static void WPS_Finished(wps_cb_status status) {
 	}
 }
 
+static void WPS_Finished(wps_cb_status status) {
+	if (!Work_Post(WPSJob_Finished, status)) {
+		// Should not happen, the queue is sized well beyond concurrent events
+		ESPAPP_DEBUG("WARNING: Work queue full, WPS result lost!\n");
+		WPSStatus = WPS_FAIL;
+	}
+}
+
 static bool WPS_Start() {
 	if (WPSStatus == WPS_PROGRESS) {
 		ESPAPP_LOG("WARNING: WPS already in progress!\n");
@@ -747,6 +2047,34 @@ static bool WPS_Start() {
 	return true;
 }
 
+static void Init_DerivePMK() {
+	if (!AppConfig.WLAN_AP_PMK.empty()) return;
+	// Open network, or the passphrase is already a hex key
+	if (AppConfig.WLAN_AP_Pass.empty()) return;
+	if (AppConfig.WLAN_AP_Pass.length() == WPA_PMK_LEN * 2) return;
+
+	ESPAPP_DEBUG("Pre-computing WiFi access point key...\n");
+	uint8_t PMK[WPA_PMK_LEN];
+	DeriveWPAPMK(AppConfig.WLAN_AP_Name, AppConfig.WLAN_AP_Pass, PMK);
+	String PMKStr;
+	for (int i = 0; i < WPA_PMK_LEN; i++) {
+		PMKStr.concat(HexLookup_UC[PMK[i] >> 4 & 0xF]);
+		PMKStr.concat(HexLookup_UC[PMK[i] & 0xF]);
+	}
+	String PMKTag = wlan_pmk_tag();
+	auto JMRet = update_config(APPLIANCE_CONFIG_FILE,
+		[&](JsonObject & obj, BoundedDynamicJsonBuffer & buf) {
+			obj[FPSTR(CONFIGKEY_WLAN_AP_PMK)] = PMKStr;
+			obj[FPSTR(CONFIGKEY_WLAN_AP_PMK_Tag)] = PMKTag;
+			return true;
+		});
+	if (JMRet != JSONMAN_OK_UPDATED) {
+		ESPAPP_DEBUG("WARNING: Unable to save WiFi access point key - "
+			"unexpected json config manager result (%d)\n", JMRet);
+	}
+	AppConfig.WLAN_AP_PMK = std::move(PMKStr);
+}
+
 static void loop_INIT() {
 	switch (AppGlobal.init.steps) {
 		case INIT_STA_CONNECT: {
@@ -756,6 +2084,14 @@ static void loop_INIT() {
 				ESPAPP_LOG("IP address: %s\n", WiFi.localIP().toString().c_str());
 				ESPAPP_DEBUG("Gateway: %s\n", WiFi.gatewayIP().toString().c_str());
 				ESPAPP_DEBUG("Name Server: %s\n", WiFi.dnsIP().toString().c_str());
+				if (AppGlobal.init.fastConnect) {
+					WLANLease Lease;
+					RTCMemory::Manager().Read(RTC_SLOT_WLANLEASE, (uint32_t*)&Lease,
+						RTC_WLANLEASE_SLOTS);
+					save_wlan_lease(Lease.Reuse + 1);
+					WLANLease_Renew();
+				} else save_wlan_lease(0);
+				Init_DerivePMK();
 				Init_NTP();
 			} else {
 				if (AppGlobal.init.authFailure) {
@@ -777,6 +2113,11 @@ static void loop_INIT() {
 				} else {
 					AppGlobal.init.lastKnownTS = GetCurrentTS();
 					time_t ConnectSpan = AppGlobal.init.lastKnownTS - AppGlobal.init.cycleTS;
+					if (AppGlobal.init.fastConnect && (AppGlobal.init.fastFailure ||
+						ConnectSpan >= WLAN_FASTCONNECT_TIMEOUT)) {
+						Init_FastConnectFallback();
+						break;
+					}
 					if (ConnectSpan < AppConfig.Init_Retry_Cycle) {
 						ESPAPP_DEBUGVVDO({
 							time_t cycleSpan = AppConfig.Init_Retry_Cycle - ConnectSpan;
@@ -786,7 +2127,7 @@ static void loop_INIT() {
 									ToString(cycleSpan, TimeUnit::SEC, true).c_str());
 							}
 						});
-						delay(100);
+						Loop_Idle(LOOP_IDLE_MAXIMUM);
 						break;
 					}
 					if (++AppGlobal.init.cycleCount < AppConfig.Init_Retry_Count) {
@@ -794,7 +2135,6 @@ static void loop_INIT() {
 							AppConfig.Init_Retry_Count - AppGlobal.init.cycleCount);
 						AppGlobal.init.cycleTS = AppGlobal.init.lastKnownTS;
 						WiFi.reconnect();
-						delay(100);
 					} else Init_TimeoutTrigger();
 				}
 			}
@@ -803,12 +2143,13 @@ static void loop_INIT() {
 		case INIT_STA_WPS: {
 			switch (WPSStatus) {
 				// WPS in progress
-				case WPS_PROGRESS: delay(100); break;
+				case WPS_PROGRESS: Loop_Idle(LOOP_IDLE_MAXIMUM); break;
 				// WPS succeeded
 				case WPS_SUCCESS: {
 					struct station_config staConfig;
 					if (wifi_station_get_config(&staConfig)) {
 						AppConfig.WLAN_AP_Pass = (char *)staConfig.password;
+						AppConfig.WLAN_AP_PMK.clear();
 						ESPAPP_DEBUGVV("WPS obtained WiFi access point password '%s'\n",
 							AppConfig.WLAN_AP_Pass.c_str());
 						auto JMRet = update_config(APPLIANCE_CONFIG_FILE,
@@ -854,7 +2195,8 @@ static void loop_INIT() {
 										ToString(cycleSpan, TimeUnit::SEC, true).c_str());
 								}
 							});
-							delay(100);
+							// No event for NTP synchronization, poll
+							Loop_Idle(LOOP_IDLE_POLL);
 							break;
 						}
 						if (++AppGlobal.init.cycleCount < AppConfig.Init_Retry_Count) {
@@ -867,16 +2209,8 @@ static void loop_INIT() {
 						break;
 					}
 					ESPAPP_LOG("NTP time synchronized @%s\n", PrintTime(curTS).c_str());
-					// Update RTC with syncrhonized time
-					RTCMemory &RTCMem = RTCMemory::Manager();
-					if (RTCMem.Write(RTC_SLOT_LASTKNOWNTS, (uint32_t*)&curTS, 1)) {
-						RTCFlags |= RTC_FLAG_TIMESYNC;
-						if (!RTCMem.Write(RTC_SLOT_FLAGS, &RTCFlags, 1)) {
-							ESPAPP_DEBUG("WARNING: Failed to update appliance flags to RTC\n");
-						}
-					} else {
-						ESPAPP_DEBUG("WARNING: Failed to update last known time to RTC\n");
-					}
+					// Anchor RTC counter to synchronized time
+					updateRTCClock();
 					// Update the stage timestamp
 					time_t StageTime = AppGlobal.init.lastKnownTS - AppGlobal.StageTS;
 					AppGlobal.StageTS = curTS - StageTime;
@@ -889,12 +2223,17 @@ static void loop_INIT() {
 					time_t curTS = AppGlobal.init.lastKnownTS;
 					// Let SNTP continue to work in the background
 					ESPAPP_LOG("NTP background synchronizing @%s\n", PrintTime(curTS).c_str());
+					// Re-anchor, so that reset loops cannot outrun the counter wrap-around
+					updateRTCClock();
 					time_t UpTime = curTS - AppGlobal.StartTS;
 					ESPAPP_DEBUG("Uptime: %s\n", ToString(UpTime, TimeUnit::SEC, true).c_str());
 				}
 				// Schedule automatic RTC updates
-				if (!RTCClockUpdate.active()) {
-					RTCClockUpdate.attach(RTC_CLOCKUPDATE, updateRTCClock);
+				if (RTCClockUpdate == WHEEL_TIMER_NONE) {
+					RTCClockUpdate = Wheel_Start(RTC_CLOCKANCHOR_REFRESH * 1000, updateRTCClock, true);
+				}
+				if (RTC_CLOCKCOARSE_REFRESH && (RTCClockCoarse == WHEEL_TIMER_NONE)) {
+					RTCClockCoarse = Wheel_Start(RTC_CLOCKCOARSE_REFRESH * 1000, updateRTCClockCoarse, true);
 				}
 			} else {
 				ESPAPP_DEBUG("NTP server not configured, synchronization skipped\n");
@@ -908,6 +2247,7 @@ static void loop_INIT() {
 				WiFi.persistent(false);
 			}
 			// Turn off STA
+			WLANStats_Leave();
 			WiFi.disconnect(true);
 			delay(100);
 			Portal_Start();
@@ -926,10 +2266,12 @@ static void loop_INIT() {
 #include "API.OTA.hpp"
 
 static bool Portal_StartAPScan() {
-	APScanInProgress = true;
-	if (AppGlobal.State == APP_PORTAL) {
-		return !AppGlobal.portal.performAPTest;
+	if ((AppGlobal.State == APP_PORTAL) && AppGlobal.portal.performAPTest) {
+		// Declined, signal the probe to yield so the request can be retried
+		AppGlobal.portal.apScanRequest = true;
+		return false;
 	}
+	APScanInProgress = true;
 	return true;
 }
 
@@ -993,6 +2335,146 @@ struct StaticResDefaults {
 };
 static LinkedList<StaticResDefaults> *PortalStaticResMap = nullptr;
 
+typedef enum {
+	PMETER_HWCTL_DEVRESET = 0,
+	PMETER_HWCTL_DEVRESTART,
+	PMETER_HWCTL_APSCAN,
+	PMETER_HWCTL_LOOPRESET,
+	PMETER_HWMON_HEAP,
+	PMETER_HWMON_UPTIME,
+	PMETER_HWMON_STAGES,
+	PMETER_HWMON_WLAN,
+	PMETER_HWMON_PORTAL,
+	PMETER_HWMON_BOOTTRACE,
+	PMETER_HWMON_FS,
+	PMETER_HWMON_TASKS,
+	PMETER_HWMON_LOOP,
+	PMETER_HWMON_EVENTS,
+	PMETER_HWMON_CONFIG,
+	PMETER_HWMON,
+	PMETER_VERSION_ZWAPP,
+	PMETER_STATE_CLOCK,
+	PMETER_STATE_WLAN,
+	PMETER_STATE_CONFIG_ZWAPP,
+	PMETER_CONFIG,
+	PMETER_OTA,
+	PMETER_BUILTIN,
+	PMETER_COUNT
+} PortalMeterIndex;
+
+static PGM_P StrPortalMeter(PortalMeterIndex idx) {
+	switch (idx) {
+		case PMETER_HWCTL_DEVRESET: return PSTR_L(PORTAL_API_HWCTL_DEVRESET);
+		case PMETER_HWCTL_DEVRESTART: return PSTR_L(PORTAL_API_HWCTL_DEVRESTART);
+		case PMETER_HWCTL_APSCAN: return PSTR_L(PORTAL_API_HWCTL_APSCAN);
+		case PMETER_HWCTL_LOOPRESET: return PSTR_L(PORTAL_API_HWCTL_LOOPRESET);
+		case PMETER_HWMON_HEAP: return PSTR_L(PORTAL_API_HWMON_HEAP);
+		case PMETER_HWMON_UPTIME: return PSTR_L(PORTAL_API_HWMON_UPTIME);
+		case PMETER_HWMON_STAGES: return PSTR_L(PORTAL_API_HWMON_STAGES);
+		case PMETER_HWMON_WLAN: return PSTR_L(PORTAL_API_HWMON_WLAN);
+		case PMETER_HWMON_PORTAL: return PSTR_L(PORTAL_API_HWMON_PORTAL);
+		case PMETER_HWMON_BOOTTRACE: return PSTR_L(PORTAL_API_HWMON_BOOTTRACE);
+		case PMETER_HWMON_FS: return PSTR_L(PORTAL_API_HWMON_FS);
+		case PMETER_HWMON_TASKS: return PSTR_L(PORTAL_API_HWMON_TASKS);
+		case PMETER_HWMON_LOOP: return PSTR_L(PORTAL_API_HWMON_LOOP);
+		case PMETER_HWMON_EVENTS: return PSTR_L(PORTAL_API_HWMON_EVENTS);
+		case PMETER_HWMON_CONFIG: return PSTR_L(PORTAL_API_HWMON_CONFIG);
+		case PMETER_HWMON: return PSTR_L(PORTAL_API_HWMON);
+		case PMETER_VERSION_ZWAPP: return PSTR_L(PORTAL_API_VERSION_ZWAPP);
+		case PMETER_STATE_CLOCK: return PSTR_L(PORTAL_API_STATE_CLOCK);
+		case PMETER_STATE_WLAN: return PSTR_L(PORTAL_API_STATE_WLAN);
+		case PMETER_STATE_CONFIG_ZWAPP: return PSTR_L(PORTAL_API_STATE_CONFIG_ZWAPP);
+		case PMETER_CONFIG: return PSTR_L(PORTAL_API_CONFIG);
+		case PMETER_OTA: return PSTR_L(PORTAL_API_OTA);
+		case PMETER_BUILTIN: return PSTR_L(PORTAL_ROOT);
+		default: return PSTR_L("<Unknown>");
+	}
+}
+
+static struct {
+	uint32_t SinceMS;
+	struct {
+		LatencyStats Latency;
+		uint32_t HeapPeak;
+	} Meter[PMETER_COUNT];
+} PortalStats;
+
+// Meters cover the current portal session only
+static void PortalStats_Reset() {
+	memset(&PortalStats, 0, sizeof(PortalStats));
+	PortalStats.SinceMS = millis();
+}
+
+// Accounts the handler time and retained heap of a portal request
+class PortalMeterScope {
+	protected:
+		PortalMeterIndex const _idx;
+		uint32_t const _startUS;
+		uint32_t const _startHeap;
+
+	public:
+		PortalMeterScope(PortalMeterIndex idx)
+			: _idx(idx), _startUS(micros()), _startHeap(ESP.getFreeHeap()) {}
+
+		~PortalMeterScope() {
+			auto &Meter = PortalStats.Meter[_idx];
+			Meter.Latency.record(micros() - _startUS);
+			uint32_t curHeap = ESP.getFreeHeap();
+			if (_startHeap > curHeap && _startHeap - curHeap > Meter.HeapPeak)
+				Meter.HeapPeak = _startHeap - curHeap;
+		}
+};
+
+// Requests still in flight on a draining portal must not steer the live one
+static void Portal_RequestStep(AsyncWebServer const *server, PortalSteps step) {
+	if ((server != AppGlobal.webServer) || (AppGlobal.wsSteps != PORTAL_UP)) {
+		ESPAPP_DEBUG("WARNING: Ignored device portal request, portal not active\n");
+		return;
+	}
+	AppGlobal.wsSteps = step;
+}
+
+static ArRequestHandlerFunction Portal_Metered(PortalMeterIndex idx,
+	ArRequestHandlerFunction const &handler) {
+	return [idx, handler](AsyncWebRequest &request) {
+		PortalMeterScope Scope(idx);
+		handler(request);
+	};
+}
+
+template<class T>
+class AsyncMeteredWebHandler: public T {
+	protected:
+		PortalMeterIndex const _meter;
+
+	public:
+		template<typename... Args>
+		AsyncMeteredWebHandler(PortalMeterIndex meter, Args&&... args)
+			: T(std::forward<Args>(args)...), _meter(meter) {}
+
+		virtual void _handleRequest(AsyncWebRequest &request) override {
+			PortalMeterScope Scope(_meter);
+			T::_handleRequest(request);
+		}
+};
+
+// Invalidates cached configs after a modifying request to the config directory
+// has completed (or was aborted), so that its content cannot be re-cached stale
+template<class T>
+class AsyncConfigCoherentWebHandler: public T {
+	public:
+		template<typename... Args>
+		AsyncConfigCoherentWebHandler(Args&&... args)
+			: T(std::forward<Args>(args)...) {}
+
+		virtual void _terminateRequest(AsyncWebRequest &request) override {
+			T::_terminateRequest(request);
+			if ((HTTP_GET | HTTP_HEAD) & request.method()) return;
+			if (!request.url().startsWith(FL(PORTAL_FSDAV CONFIG_DIR))) return;
+			ConfigCache_Invalidate();
+		}
+};
+
 static void Portal_WebServer_Operations() {
 	switch (AppGlobal.wsSteps) {
 		case PORTAL_OFF:
@@ -1006,7 +2488,8 @@ static void Portal_WebServer_Operations() {
 
 		case PORTAL_SETUP: {
 			ESPAPP_DEBUG("Bringing up portal service...\n");
-			AppGlobal.webServer = new AsyncWebServer(80);
+			AppGlobal.webServer = new AsyncWebServer(PORTAL_HTTP_PORT);
+			PortalStats_Reset();
 			AppGlobal.webServer->configRealm(AppConfig.Hostname);
 			AppGlobal.wsSteps = PORTAL_ACCOUNT;
 		} break;
@@ -1050,78 +2533,313 @@ static void Portal_WebServer_Operations() {
 				}
 			}
 
-			AuthSession fakeAnonyAuth(IdentityProvider::ANONYMOUS, nullptr);
-			if (AppGlobal.webServer->_checkACL(HTTP_GET, FL(PORTAL_ROOT), &fakeAnonyAuth) != ACL_ALLOWED) {
-				ESPAPP_DEBUG("WARNING: correcting ACL to allow '%s' access to portal root...\n",
-					SFPSTR(FL(ANONYMOUS_ID)));
-				AppGlobal.webServer->_prependACL(FL(PORTAL_ROOT), HTTP_BASIC_READ,
-					{nullptr, {&IdentityProvider::ANONYMOUS}});
-			}
+			AuthSession fakeAnonyAuth(IdentityProvider::ANONYMOUS, nullptr);
+			if (AppGlobal.webServer->_checkACL(HTTP_GET, FL(PORTAL_ROOT), &fakeAnonyAuth) != ACL_ALLOWED) {
+				ESPAPP_DEBUG("WARNING: correcting ACL to allow '%s' access to portal root...\n",
+					SFPSTR(FL(ANONYMOUS_ID)));
+				AppGlobal.webServer->_prependACL(FL(PORTAL_ROOT), HTTP_BASIC_READ,
+					{nullptr, {&IdentityProvider::ANONYMOUS}});
+			}
+			{
+				auto &AdminIdent = AppGlobal.webAccounts->getIdentity(FL(PORTAL_ADMIN_USER));
+				AuthSession fakeAdminAuth(AdminIdent, nullptr);
+				if (AppGlobal.webServer->_checkACL(HTTP_PUT, FL(PORTAL_FSDAV_ROOT), &fakeAdminAuth) != ACL_ALLOWED ||
+					AppGlobal.webServer->_checkACL(HTTP_PUT, FL(PORTAL_FSDAV_ROOT), &fakeAnonyAuth) == ACL_ALLOWED) {
+					ESPAPP_DEBUG("WARNING: correcting ACL to allow '%s' exclusive access to '%s'...\n",
+						SFPSTR(FL(PORTAL_ADMIN_USER)), SFPSTR(FL(PORTAL_FSDAV_ROOT)));
+					AppGlobal.webServer->_prependACL(FL(PORTAL_FSDAV_ROOT), HTTP_ANY,
+						{nullptr, {&AdminIdent}});
+				}
+				if (AppGlobal.webServer->_checkACL(HTTP_GET, FL(PORTAL_API_HWCTL), &fakeAdminAuth) != ACL_ALLOWED ||
+					AppGlobal.webServer->_checkACL(HTTP_GET, FL(PORTAL_API_HWCTL), &fakeAnonyAuth) == ACL_ALLOWED) {
+					ESPAPP_DEBUG("WARNING: correcting ACL to allow '%s' exclusive access to '%s'...\n",
+						SFPSTR(FL(PORTAL_ADMIN_USER)), SFPSTR(FL(PORTAL_API_HWCTL)));
+					AppGlobal.webServer->_prependACL(FL(PORTAL_API_HWCTL), HTTP_BASIC_READ,
+						{nullptr, {&AdminIdent}});
+				}
+			}
+			AppGlobal.wsSteps = PORTAL_FILES;
+		} break;
+
+		case PORTAL_FILES: {
+			auto PortalDir = get_dir(FL(PORTAL_DIR));
+
+			PortalStaticResMap = new LinkedList<StaticResDefaults>(nullptr);
+			PortalStaticResMap->append({PSTR_L(PORTAL_ROOT PORTAL_PAGE_OTA), PORTAL_RESDATA_OTA_HTML});
+			PortalStaticResMap->append({PSTR_L(PORTAL_ROOT PORTAL_RES_MD5JS), PORTAL_RESDATA_MD5_JS});
+			PortalStaticResMap->append({PSTR_L(PORTAL_ROOT PORTAL_RES_OTACOREJS), PORTAL_RESDATA_OTACORE_JS});
+
+			PortalStaticResMap->append({PSTR_L(PORTAL_ROOT PORTAL_PAGE_SYSCONFIG), PORTAL_RESDATA_SYSCONFIG_HTML});
+			PortalStaticResMap->append({PSTR_L(PORTAL_ROOT PORTAL_RES_JQUERYJS), PORTAL_RESDATA_JQUERY_JS});
+			PortalStaticResMap->append({PSTR_L(PORTAL_ROOT PORTAL_RES_APSCANCOREJS), PORTAL_RESDATA_APSCANCORE_JS});
+
+			AppGlobal.wsSteps = PORTAL_START;
+		} break;
+
+		case PORTAL_START: {
+			bool isCaptive = AppGlobal.State == APP_PORTAL;
+
+			if (isCaptive) {
+				// Redirect all request to this host (and hence being captive)
+				auto pHandler = new AsyncHostRedirWebHandler(AppConfig.Hostname, HTTP_ANY);
+				pHandler->altPath = PORTAL_ROOT;
+				pHandler->psvPaths.append(FL(PORTAL_WPAD_FILE));
+				AppGlobal.webServer->addHandler(pHandler).addFilter(
+					[&](AsyncWebRequest const &request) {
+						// Record last activity time stamp
+						AppGlobal.wsActivityTS = GetCurrentTS();
+						Loop_Wakeup();
+						return true;
+					});
+			} else {
+				AppGlobal.webServer->addHandler(new AsyncPassthroughWebHandler()).addFilter(
+					[&](AsyncWebRequest const &request) {
+						// Record last activity time stamp
+						AppGlobal.wsActivityTS = GetCurrentTS();
+						Loop_Wakeup();
+						return false;
+					});
+			}
+
+			{
+				if (isCaptive) {
+					auto &Handler = AppGlobal.webServer->on(FL(PORTAL_WPAD_FILE"$"),
+						[](AsyncWebRequest &request) {
+							request.send(404);
+						});
+					Handler.addFilter([](AsyncWebRequest const &request) {
+						return request.host().equalsIgnoreCase(AppConfig.Hostname);
+					});
+				}
+			}
+
+			{
+				AsyncWebServer *Server = AppGlobal.webServer;
+				auto &Handler = AppGlobal.webServer->on(FL(PORTAL_API_HWCTL_DEVRESET"$"),
+					Portal_Metered(PMETER_HWCTL_DEVRESET, [Server](AsyncWebRequest &request) {
+						Portal_WebServer_RespondFileOrBuiltIn(request,
+							FL(PORTAL_PAGE_DEVRESET), PORTAL_RESDATA_DEVRESET_HTML);
+						Portal_RequestStep(Server, PORTAL_DEVRESET);
+					}));
+				if (isCaptive) {
+					Handler.addFilter([](AsyncWebRequest const &request) {
+						return request.host().equalsIgnoreCase(AppConfig.Hostname);
+					});
+				}
+			}
+
+			{
+				AsyncWebServer *Server = AppGlobal.webServer;
+				auto &Handler = AppGlobal.webServer->on(FL(PORTAL_API_HWCTL_DEVRESTART"$"),
+					Portal_Metered(PMETER_HWCTL_DEVRESTART, [Server](AsyncWebRequest &request) {
+						Portal_WebServer_RespondFileOrBuiltIn(request,
+							FL(PORTAL_PAGE_DEVRESTART), PORTAL_RESDATA_DEVRESTART_HTML);
+						Portal_RequestStep(Server, PORTAL_DEVRESTART);
+					}));
+				if (isCaptive) {
+					Handler.addFilter([](AsyncWebRequest const &request) {
+						return request.host().equalsIgnoreCase(AppConfig.Hostname);
+					});
+				}
+			}
+
+			{
+				auto &Handler = AppGlobal.webServer->on(FL(PORTAL_API_HWCTL_LOOPRESET"$"),
+					Portal_Metered(PMETER_HWCTL_LOOPRESET, [](AsyncWebRequest &request) {
+						LoopStats_Reset();
+						request.send(204);
+					}));
+				if (isCaptive) {
+					Handler.addFilter([](AsyncWebRequest const &request) {
+						return request.host().equalsIgnoreCase(AppConfig.Hostname);
+					});
+				}
+			}
+
+			{
+				auto &Handler = AppGlobal.webServer->on(FL(PORTAL_API_HWMON_HEAP"$"),
+					Portal_Metered(PMETER_HWMON_HEAP, [](AsyncWebRequest &request) {
+						size_t FreeHeap = ESP.getFreeHeap();
+						request.send(200, String(FreeHeap), FL("text/plain"));
+					}));
+				if (isCaptive) {
+					Handler.addFilter([](AsyncWebRequest const &request) {
+						return request.host().equalsIgnoreCase(AppConfig.Hostname);
+					});
+				}
+			}
+
+			{
+				auto &Handler = AppGlobal.webServer->on(FL(PORTAL_API_HWMON_UPTIME"$"),
+					Portal_Metered(PMETER_HWMON_UPTIME, [](AsyncWebRequest &request) {
+						time_t UpTime = GetCurrentTS() - AppGlobal.StartTS;
+						request.send(200, String(UpTime), FL("text/plain"));
+					}));
+				if (isCaptive) {
+					Handler.addFilter([](AsyncWebRequest const &request) {
+						return request.host().equalsIgnoreCase(AppConfig.Hostname);
+					});
+				}
+			}
+
+			{
+				auto &Handler = AppGlobal.webServer->on(FL(PORTAL_API_HWMON_STAGES"$"),
+					Portal_Metered(PMETER_HWMON_STAGES, [](AsyncWebRequest &request) {
+						uint32_t curMS = millis();
+						AsyncJsonResponse * response =
+							AsyncJsonResponse::CreateNewObjectResponse(200, 1024);
+						JsonObject &Root = response->root.as<JsonObject&>();
+						{
+							JsonObject &Boot = Root.createNestedObject(FL("boot"));
+							Boot[FL("reason")] = String(FPSTR(resetReasonToStr(resetInfo.reason)));
+							Boot[FL("warm")] = (bool)(RTCFlags & RTC_FLAG_RESTORED);
+							Boot[FL("timesync")] = (bool)(RTCFlags & RTC_FLAG_TIMESYNC);
+							Boot[FL("setup")] = StageStats.SetupMS;
+						}
+						{
+							JsonArray &Stages = Root.createNestedArray(FL("stages"));
+							uint16_t Idx = StageStats.Count > STAGE_LOG_DEPTH?
+								StageStats.Count - STAGE_LOG_DEPTH : 0;
+							for (; Idx < StageStats.Count; Idx++) {
+								auto &Record = StageStats.Log[Idx % STAGE_LOG_DEPTH];
+								JsonObject &Stage = Stages.createNestedObject();
+								Stage[FL("state")] = String(FPSTR(StrAppState(Record.State)));
+								Stage[FL("start")] = Record.StartMS;
+								Stage[FL("span")] = Record.SpanMS;
+							}
+						}
+						{
+							JsonObject &Stage = Root.createNestedObject(FL("current"));
+							Stage[FL("state")] = String(FPSTR(StrAppState(AppGlobal.State)));
+							Stage[FL("start")] = StageStats.StageMS;
+							Stage[FL("span")] = curMS - StageStats.StageMS;
+						}
+						request.send(response);
+					}));
+				if (isCaptive) {
+					Handler.addFilter([](AsyncWebRequest const &request) {
+						return request.host().equalsIgnoreCase(AppConfig.Hostname);
+					});
+				}
+			}
+
+			{
+				auto &Handler = AppGlobal.webServer->on(FL(PORTAL_API_HWMON_WLAN"$"),
+					Portal_Metered(PMETER_HWMON_WLAN, [](AsyncWebRequest &request) {
+						uint32_t curMS = millis();
+						AsyncJsonResponse * response =
+							AsyncJsonResponse::CreateNewObjectResponse();
+						JsonObject &Root = response->root.as<JsonObject&>();
+						Root[FL("online")] = WLANStats.OnlineMS;
+						Root[FL("down")] = WLANStats.DownMS? curMS - WLANStats.DownMS : 0;
+						Root[FL("disconnects")] = WLANStats.Disconnects;
+						{
+							JsonObject &Reconnect = Root.createNestedObject(FL("reconnect"));
+							Reconnect[FL("count")] = WLANStats.Reconnects;
+							Reconnect[FL("avg")] = WLANStats.Reconnects?
+								WLANStats.ReconnectTotalMS / WLANStats.Reconnects : 0;
+							Reconnect[FL("max")] = WLANStats.ReconnectMaxMS;
+						}
+						{
+							JsonObject &Portal = Root.createNestedObject(FL("portal"));
+							Portal[FL("count")] = WLANStats.PortalCount;
+							Portal[FL("span")] = WLANStats.PortalTotalMS +
+								(AppGlobal.State == APP_PORTAL? curMS - StageStats.StageMS : 0);
+						}
+						{
+							JsonArray &Reasons = Root.createNestedArray(FL("reasons"));
+							uint16_t Idx = WLANStats.ReasonCount > WLAN_REASON_DEPTH?
+								WLANStats.ReasonCount - WLAN_REASON_DEPTH : 0;
+							for (; Idx < WLANStats.ReasonCount; Idx++)
+								Reasons.add(WLANStats.Reasons[Idx % WLAN_REASON_DEPTH]);
+						}
+						request.send(response);
+					}));
+				if (isCaptive) {
+					Handler.addFilter([](AsyncWebRequest const &request) {
+						return request.host().equalsIgnoreCase(AppConfig.Hostname);
+					});
+				}
+			}
+
 			{
-				auto &AdminIdent = AppGlobal.webAccounts->getIdentity(FL(PORTAL_ADMIN_USER));
-				AuthSession fakeAdminAuth(AdminIdent, nullptr);
-				if (AppGlobal.webServer->_checkACL(HTTP_PUT, FL(PORTAL_FSDAV_ROOT), &fakeAdminAuth) != ACL_ALLOWED ||
-					AppGlobal.webServer->_checkACL(HTTP_PUT, FL(PORTAL_FSDAV_ROOT), &fakeAnonyAuth) == ACL_ALLOWED) {
-					ESPAPP_DEBUG("WARNING: correcting ACL to allow '%s' exclusive access to '%s'...\n",
-						SFPSTR(FL(PORTAL_ADMIN_USER)), SFPSTR(FL(PORTAL_FSDAV_ROOT)));
-					AppGlobal.webServer->_prependACL(FL(PORTAL_FSDAV_ROOT), HTTP_ANY,
-						{nullptr, {&AdminIdent}});
-				}
-				if (AppGlobal.webServer->_checkACL(HTTP_GET, FL(PORTAL_API_HWCTL), &fakeAdminAuth) != ACL_ALLOWED ||
-					AppGlobal.webServer->_checkACL(HTTP_GET, FL(PORTAL_API_HWCTL), &fakeAnonyAuth) == ACL_ALLOWED) {
-					ESPAPP_DEBUG("WARNING: correcting ACL to allow '%s' exclusive access to '%s'...\n",
-						SFPSTR(FL(PORTAL_ADMIN_USER)), SFPSTR(FL(PORTAL_API_HWCTL)));
-					AppGlobal.webServer->_prependACL(FL(PORTAL_API_HWCTL), HTTP_BASIC_READ,
-						{nullptr, {&AdminIdent}});
+				auto &Handler = AppGlobal.webServer->on(FL(PORTAL_API_HWMON_PORTAL"$"),
+					Portal_Metered(PMETER_HWMON_PORTAL, [](AsyncWebRequest &request) {
+						uint32_t Span = millis() - PortalStats.SinceMS;
+						AsyncJsonResponse * response =
+							AsyncJsonResponse::CreateNewObjectResponse(200, 3072);
+						JsonObject &Root = response->root.as<JsonObject&>();
+						Root[FL("span")] = Span;
+						JsonObject &Meters = Root.createNestedObject(FL("meters"));
+						for (int i = 0; i < PMETER_COUNT; i++) {
+							auto &Meter = PortalStats.Meter[i];
+							if (!Meter.Latency.Count) continue;
+							JsonObject &Entry = Meters.createNestedObject(
+								String(FPSTR(StrPortalMeter((PortalMeterIndex)i))));
+							Meter.Latency.printTo(Entry);
+							Entry[FL("rps")] = Span? Meter.Latency.Count * 1000.0 / Span : 0;
+							Entry[FL("heap")] = Meter.HeapPeak;
+						}
+						request.send(response);
+					}));
+				if (isCaptive) {
+					Handler.addFilter([](AsyncWebRequest const &request) {
+						return request.host().equalsIgnoreCase(AppConfig.Hostname);
+					});
 				}
 			}
-			AppGlobal.wsSteps = PORTAL_FILES;
-		} break;
-
-		case PORTAL_FILES: {
-			auto PortalDir = get_dir(FL(PORTAL_DIR));
-
-			PortalStaticResMap = new LinkedList<StaticResDefaults>(nullptr);
-			PortalStaticResMap->append({PSTR_L(PORTAL_ROOT PORTAL_PAGE_OTA), PORTAL_RESDATA_OTA_HTML});
-			PortalStaticResMap->append({PSTR_L(PORTAL_ROOT PORTAL_RES_MD5JS), PORTAL_RESDATA_MD5_JS});
-			PortalStaticResMap->append({PSTR_L(PORTAL_ROOT PORTAL_RES_OTACOREJS), PORTAL_RESDATA_OTACORE_JS});
-
-			PortalStaticResMap->append({PSTR_L(PORTAL_ROOT PORTAL_PAGE_SYSCONFIG), PORTAL_RESDATA_SYSCONFIG_HTML});
-			PortalStaticResMap->append({PSTR_L(PORTAL_ROOT PORTAL_RES_JQUERYJS), PORTAL_RESDATA_JQUERY_JS});
-			PortalStaticResMap->append({PSTR_L(PORTAL_ROOT PORTAL_RES_APSCANCOREJS), PORTAL_RESDATA_APSCANCORE_JS});
-
-			AppGlobal.wsSteps = PORTAL_START;
-		} break;
 
-		case PORTAL_START: {
-			bool isCaptive = AppGlobal.State == APP_PORTAL;
-
-			if (isCaptive) {
-				// Redirect all request to this host (and hence being captive)
-				auto pHandler = new AsyncHostRedirWebHandler(AppConfig.Hostname, HTTP_ANY);
-				pHandler->altPath = PORTAL_ROOT;
-				pHandler->psvPaths.append(FL(PORTAL_WPAD_FILE));
-				AppGlobal.webServer->addHandler(pHandler).addFilter(
-					[&](AsyncWebRequest const &request) {
-						// Record last activity time stamp
-						AppGlobal.wsActivityTS = GetCurrentTS();
-						return true;
-					});
-			} else {
-				AppGlobal.webServer->addHandler(new AsyncPassthroughWebHandler()).addFilter(
-					[&](AsyncWebRequest const &request) {
-						// Record last activity time stamp
-						AppGlobal.wsActivityTS = GetCurrentTS();
-						return false;
+			{
+				auto &Handler = AppGlobal.webServer->on(FL(PORTAL_API_HWMON_BOOTTRACE"$"),
+					Portal_Metered(PMETER_HWMON_BOOTTRACE, [](AsyncWebRequest &request) {
+						RTCMemory &RTCMem = RTCMemory::Manager();
+						AsyncJsonResponse * response =
+							AsyncJsonResponse::CreateNewArrayResponse(200, 1024);
+						JsonArray &Root = response->root.as<JsonArray&>();
+						for (uint8_t i = 0; i < BOOTTRACE_DEPTH; i++) {
+							uint32_t Record[BOOTTRACE_RECORD_SLOTS];
+							if (!RTCMem.Read(RTC_SLOT_BOOTTRACE + i * BOOTTRACE_RECORD_SLOTS,
+								Record, BOOTTRACE_RECORD_SLOTS)) continue;
+							if ((Record[0] >> 24) != BOOTTRACE_MAGIC) continue;
+							JsonObject &Boot = Root.createNestedObject();
+							Boot[FL("seq")] = Record[0] & 0xFFFF;
+							Boot[FL("reason")] = String(FPSTR(resetReasonToStr(Record[0] >> 16 & 0xFF)));
+							Boot[FL("current")] = i == BootTraceSlot;
+							JsonObject &Trace = Boot.createNestedObject(FL("trace"));
+							for (int j = 0; j < BOOTTRACE_POINTS; j++) {
+								if (!Record[1 + j]) continue;
+								Trace[String(FPSTR(StrBootTracePoint((BootTracePoint)j)))] = Record[1 + j];
+							}
+						}
+						request.send(response);
+					}));
+				if (isCaptive) {
+					Handler.addFilter([](AsyncWebRequest const &request) {
+						return request.host().equalsIgnoreCase(AppConfig.Hostname);
 					});
+				}
 			}
 
 			{
+				auto &Handler = AppGlobal.webServer->on(FL(PORTAL_API_HWMON_FS"$"),
+					Portal_Metered(PMETER_HWMON_FS, [](AsyncWebRequest &request) {
+						uint32_t Age = millis() - FSStats.UpdateMS;
+						if (!FSStats.Valid || Age >= FSSTATS_REFRESH * 1000) {
+							// Collect in main loop, do not stall the web server
+							FSStats.Refresh = true;
+						}
+						if (!FSStats.Valid) {
+							request.send(204);
+							return;
+						}
+						AsyncJsonResponse * response =
+							AsyncJsonResponse::CreateNewObjectResponse();
+						response->root[FL("total")] = FSStats.Info.totalBytes;
+						response->root[FL("used")] = FSStats.Info.usedBytes;
+						response->root[FL("age")] = Age;
+						request.send(response);
+					}));
 				if (isCaptive) {
-					auto &Handler = AppGlobal.webServer->on(FL(PORTAL_WPAD_FILE"$"),
-						[](AsyncWebRequest &request) {
-							request.send(404);
-						});
 					Handler.addFilter([](AsyncWebRequest const &request) {
 						return request.host().equalsIgnoreCase(AppConfig.Hostname);
 					});
@@ -1129,12 +2847,24 @@ static void Portal_WebServer_Operations() {
 			}
 
 			{
-				auto &Handler = AppGlobal.webServer->on(FL(PORTAL_API_HWCTL_DEVRESET"$"),
-					[](AsyncWebRequest &request) {
-						Portal_WebServer_RespondFileOrBuiltIn(request,
-							FL(PORTAL_PAGE_DEVRESET), PORTAL_RESDATA_DEVRESET_HTML);
-						AppGlobal.wsSteps = PORTAL_DEVRESET;
-					});
+				auto &Handler = AppGlobal.webServer->on(FL(PORTAL_API_HWMON_TASKS"$"),
+					Portal_Metered(PMETER_HWMON_TASKS, [](AsyncWebRequest &request) {
+						AsyncJsonResponse * response =
+							AsyncJsonResponse::CreateNewArrayResponse(200, 2048);
+						JsonArray &Root = response->root.as<JsonArray&>();
+						for (int8_t i = 0; i < SERVICE_TASK_SLOTS; i++) {
+							auto &Task = ServiceTasks[i];
+							if (!Task.Seq) continue;
+							JsonObject &Entry = Root.createNestedObject();
+							Entry[FL("id")] = i;
+							Entry[FL("name")] = Task.Name;
+							Entry[FL("type")] = String(FPSTR(StrTaskType(Task.Type)));
+							if (Task.Type == TASK_PERIODIC)
+								Entry[FL("period")] = Task.PeriodMS;
+							Task.Runtime.printTo(Entry);
+						}
+						request.send(response);
+					}));
 				if (isCaptive) {
 					Handler.addFilter([](AsyncWebRequest const &request) {
 						return request.host().equalsIgnoreCase(AppConfig.Hostname);
@@ -1143,12 +2873,28 @@ static void Portal_WebServer_Operations() {
 			}
 
 			{
-				auto &Handler = AppGlobal.webServer->on(FL(PORTAL_API_HWCTL_DEVRESTART"$"),
-					[](AsyncWebRequest &request) {
-						Portal_WebServer_RespondFileOrBuiltIn(request,
-							FL(PORTAL_PAGE_DEVRESTART), PORTAL_RESDATA_DEVRESTART_HTML);
-						AppGlobal.wsSteps = PORTAL_DEVRESTART;
-					});
+				auto &Handler = AppGlobal.webServer->on(FL(PORTAL_API_HWMON_LOOP"$"),
+					Portal_Metered(PMETER_HWMON_LOOP, [](AsyncWebRequest &request) {
+						AsyncJsonResponse * response =
+							AsyncJsonResponse::CreateNewObjectResponse(200, 2048);
+						JsonObject &Root = response->root.as<JsonObject&>();
+						Root[FL("span")] = millis() - LoopStats.SinceMS;
+						JsonObject &Queue = Root.createNestedObject(FL("queue"));
+						Queue[FL("posted")] = WorkQueue.Posted;
+						Queue[FL("dropped")] = WorkQueue.Dropped;
+						Queue[FL("peak")] = WorkQueue.Peak;
+						for (int i = 0; i < LOOP_STATS_STATES; i++) {
+							if (!LoopStats.Gap[i].Count) continue;
+							JsonObject &Entry = Root.createNestedObject(
+								String(FPSTR(StrAppState((AppState)i))));
+							JsonObject &User = Entry.createNestedObject(FL("user"));
+							LoopStats.User[i].printTo(User);
+							JsonObject &Gap = Entry.createNestedObject(FL("gap"));
+							LoopStats.Gap[i].printTo(Gap);
+							Entry[FL("idle")] = (uint32_t)(LoopStats.IdleTotalUS[i] / 1000);
+						}
+						request.send(response);
+					}));
 				if (isCaptive) {
 					Handler.addFilter([](AsyncWebRequest const &request) {
 						return request.host().equalsIgnoreCase(AppConfig.Hostname);
@@ -1157,11 +2903,22 @@ static void Portal_WebServer_Operations() {
 			}
 
 			{
-				auto &Handler = AppGlobal.webServer->on(FL(PORTAL_API_HWMON_HEAP"$"),
-					[](AsyncWebRequest &request) {
-						size_t FreeHeap = ESP.getFreeHeap();
-						request.send(200, String(FreeHeap), FL("text/plain"));
-					});
+				auto &Handler = AppGlobal.webServer->on(FL(PORTAL_API_HWMON_EVENTS"$"),
+					Portal_Metered(PMETER_HWMON_EVENTS, [](AsyncWebRequest &request) {
+						AsyncJsonResponse * response =
+							AsyncJsonResponse::CreateNewArrayResponse(200, 1024);
+						JsonArray &Root = response->root.as<JsonArray&>();
+						EventLog_Enum([&](EventRecord const &record) {
+							JsonObject &Entry = Root.createNestedObject();
+							Entry[FL("seq")] = record.Seq;
+							Entry[FL("event")] = String(FPSTR(StrEventType((EventType)record.Type)));
+							if (record.Type & EVENT_USER)
+								Entry[FL("code")] = record.Type & ~EVENT_USER;
+							Entry[FL("arg")] = record.Arg;
+							Entry[FL("ms")] = record.MS;
+						});
+						request.send(response);
+					}));
 				if (isCaptive) {
 					Handler.addFilter([](AsyncWebRequest const &request) {
 						return request.host().equalsIgnoreCase(AppConfig.Hostname);
@@ -1170,11 +2927,16 @@ static void Portal_WebServer_Operations() {
 			}
 
 			{
-				auto &Handler = AppGlobal.webServer->on(FL(PORTAL_API_HWMON_UPTIME"$"),
-					[](AsyncWebRequest &request) {
-						time_t UpTime = GetCurrentTS() - AppGlobal.StartTS;
-						request.send(200, String(UpTime), FL("text/plain"));
-					});
+				auto &Handler = AppGlobal.webServer->on(FL(PORTAL_API_HWMON_CONFIG"$"),
+					Portal_Metered(PMETER_HWMON_CONFIG, [](AsyncWebRequest &request) {
+						AsyncJsonResponse * response =
+							AsyncJsonResponse::CreateNewObjectResponse();
+						response->root[FL("written")] = JsonManagerStats.Written;
+						response->root[FL("unchanged")] = JsonManagerStats.Unchanged;
+						response->root[FL("failed")] = JsonManagerStats.Failed;
+						response->root[FL("recovered")] = JsonManagerStats.Recovered;
+						request.send(response);
+					}));
 				if (isCaptive) {
 					Handler.addFilter([](AsyncWebRequest const &request) {
 						return request.host().equalsIgnoreCase(AppConfig.Hostname);
@@ -1184,7 +2946,7 @@ static void Portal_WebServer_Operations() {
 
 			{
 				auto &Handler = AppGlobal.webServer->on(FL(PORTAL_API_HWMON),
-					[](AsyncWebRequest &request) {
+					Portal_Metered(PMETER_HWMON, [](AsyncWebRequest &request) {
 						size_t FreeHeap = ESP.getFreeHeap();
 						time_t UpTime = GetCurrentTS() - AppGlobal.StartTS;
 						AsyncJsonResponse * response =
@@ -1192,7 +2954,7 @@ static void Portal_WebServer_Operations() {
 						response->root[FL("heap")] = FreeHeap;
 						response->root[FL("uptime")] = UpTime;
 						request.send(response);
-					});
+					}));
 				if (isCaptive) {
 					Handler.addFilter([](AsyncWebRequest const &request) {
 						return request.host().equalsIgnoreCase(AppConfig.Hostname);
@@ -1202,9 +2964,9 @@ static void Portal_WebServer_Operations() {
 
 			{
 				auto &Handler = AppGlobal.webServer->on(FL(PORTAL_API_VERSION_ZWAPP"$"),
-				[](AsyncWebRequest &request) {
+				Portal_Metered(PMETER_VERSION_ZWAPP, [](AsyncWebRequest &request) {
 					request.send_P(200, PSTR_L(ZWAPP_VERSION), FL("text/plain"));
-				});
+				}));
 				if (isCaptive) {
 					Handler.addFilter([](AsyncWebRequest const &request) {
 						return request.host().equalsIgnoreCase(AppConfig.Hostname);
@@ -1214,7 +2976,7 @@ static void Portal_WebServer_Operations() {
 
 			{
 				auto &Handler = AppGlobal.webServer->on(FL(PORTAL_API_STATE_CLOCK"$"),
-					[](AsyncWebRequest &request) {
+					Portal_Metered(PMETER_STATE_CLOCK, [](AsyncWebRequest &request) {
 						time_t utc_clock = sntp_get_current_timestamp();
 						TimeChangeRule* TZ;
 						time_t clock = AppConfig.TZ.toLocal(utc_clock, &TZ);
@@ -1233,7 +2995,7 @@ static void Portal_WebServer_Operations() {
 						response->root[FL("Z")] = TZ->abbrev;
 						response->root[FL("z")] = TZ->offset;
 						request.send(response);
-					});
+					}));
 				if (isCaptive) {
 					Handler.addFilter([](AsyncWebRequest const &request) {
 						return request.host().equalsIgnoreCase(AppConfig.Hostname);
@@ -1243,7 +3005,7 @@ static void Portal_WebServer_Operations() {
 
 			{
 				auto &Handler = AppGlobal.webServer->on(FL(PORTAL_API_STATE_WLAN"$"),
-				[](AsyncWebRequest &request) {
+				Portal_Metered(PMETER_STATE_WLAN, [](AsyncWebRequest &request) {
 					AsyncJsonResponse * response =
 						AsyncJsonResponse::CreateNewObjectResponse();
 					JsonObject &Root = response->root.as<JsonObject&>();
@@ -1302,7 +3064,7 @@ static void Portal_WebServer_Operations() {
 						}
 					}
 					request.send(response);
-				});
+				}));
 				if (isCaptive) {
 					Handler.addFilter([](AsyncWebRequest const &request) {
 						return request.host().equalsIgnoreCase(AppConfig.Hostname);
@@ -1312,7 +3074,7 @@ static void Portal_WebServer_Operations() {
 
 			{
 				auto &Handler = AppGlobal.webServer->on(FL(PORTAL_API_STATE_CONFIG_ZWAPP"$"),
-				[](AsyncWebRequest &request) {
+				Portal_Metered(PMETER_STATE_CONFIG_ZWAPP, [](AsyncWebRequest &request) {
 					AsyncJsonResponse * response =
 						AsyncJsonResponse::CreateNewObjectResponse();
 					JsonObject &Root = response->root.as<JsonObject&>();
@@ -1364,7 +3126,7 @@ static void Portal_WebServer_Operations() {
 					}
 
 					request.send(response);
-				});
+				}));
 				if (isCaptive) {
 					Handler.addFilter([](AsyncWebRequest const &request) {
 						return request.host().equalsIgnoreCase(AppConfig.Hostname);
@@ -1374,7 +3136,8 @@ static void Portal_WebServer_Operations() {
 
 			{
 				auto &Handler = AppGlobal.webServer->addHandler(
-					new AsyncAPIAPScanWebHandler(FL(PORTAL_API_HWCTL_APSCAN))
+					new AsyncMeteredWebHandler<AsyncAPIAPScanWebHandler>(PMETER_HWCTL_APSCAN,
+						FL(PORTAL_API_HWCTL_APSCAN))
 				);
 				if (isCaptive) {
 					Handler.addFilter([](AsyncWebRequest const &request) {
@@ -1385,8 +3148,8 @@ static void Portal_WebServer_Operations() {
 
 			{
 				auto &Handler = AppGlobal.webServer->addHandler(
-					new AsyncAPIConfigWebHandler(FL(PORTAL_API_CONFIG),
-						get_dir(FL(CONFIG_DIR)))
+					new AsyncMeteredWebHandler<AsyncAPIConfigWebHandler>(PMETER_CONFIG,
+						FL(PORTAL_API_CONFIG), get_dir(FL(CONFIG_DIR)), ConfigCache_Sync)
 				);
 				if (isCaptive) {
 					Handler.addFilter([](AsyncWebRequest const &request) {
@@ -1397,8 +3160,12 @@ static void Portal_WebServer_Operations() {
 
 			{
 				auto &Handler = AppGlobal.webServer->addHandler(
-					new AsyncAPIOTAWebHandler(FL(PORTAL_API_OTA),
-						FL(PORTAL_ROOT PORTAL_PAGE_OTA))
+					new AsyncMeteredWebHandler<AsyncAPIOTAWebHandler>(PMETER_OTA,
+						FL(PORTAL_API_OTA), FL(PORTAL_ROOT PORTAL_PAGE_OTA),
+						[](OTAEvent event) {
+							EventLog_Append(event == OTA_BEGIN? EVENT_OTA_BEGIN : EVENT_OTA_END,
+								event);
+						})
 				);
 				if (isCaptive) {
 					Handler.addFilter([](AsyncWebRequest const &request) {
@@ -1408,9 +3175,12 @@ static void Portal_WebServer_Operations() {
 			}
 
 			{
-				auto &Handler = AppGlobal.webServer->serveStatic(FL(PORTAL_FSDAV_ROOT),
-					VFATFS.openDir(FL("/")), String::EMPTY, FL(DEFAULT_CACHE_CTRL),
-					true, true);
+				// Keep cached configs coherent with WebDAV writes
+				auto &Handler = AppGlobal.webServer->addHandler(
+					new AsyncConfigCoherentWebHandler<AsyncStaticWebHandler>(
+						FL(PORTAL_FSDAV_ROOT), VFATFS.openDir(FL("/")), String::EMPTY,
+						FL(DEFAULT_CACHE_CTRL), true, true)
+				);
 				if (isCaptive) {
 					Handler.addFilter([](AsyncWebRequest const &request) {
 						return request.host().equalsIgnoreCase(AppConfig.Hostname);
@@ -1427,27 +3197,34 @@ static void Portal_WebServer_Operations() {
 					});
 				}
 
-				Handler._onGETIndexNotFound = [](AsyncWebRequest &request) {
-					if (request.url() == FL(PORTAL_ROOT)) {
-						Portal_WebServer_RespondBuiltInData(request,
-							PORTAL_RESDATA_INDEX_HTML, FL(PORTAL_PAGE_INDEX));
-					} else {
-						// Do not allow directory listing
-						request.send(403);
-					}
-				};
+				Handler._onGETIndexNotFound = Portal_Metered(PMETER_BUILTIN,
+					[](AsyncWebRequest &request) {
+						if (request.url() == FL(PORTAL_ROOT)) {
+							Portal_WebServer_RespondBuiltInData(request,
+								PORTAL_RESDATA_INDEX_HTML, FL(PORTAL_PAGE_INDEX));
+						} else {
+							// Do not allow directory listing
+							request.send(403);
+						}
+					});
 
-				Handler._onGETPathNotFound = [](AsyncWebRequest &request) {
-					auto ResEntry = PortalStaticResMap->get_if([&](StaticResDefaults const &X) {
-						ESPAPP_DEBUGVV("* Matching '%s' with built-in data '%s'...\n",
-							request.url().c_str(), SFPSTR(X.Path));
-						return (request.url() == FPSTR(X.Path));
+				Handler._onGETPathNotFound = Portal_Metered(PMETER_BUILTIN,
+					[](AsyncWebRequest &request) {
+						// Portal may be draining
+						if (!PortalStaticResMap) {
+							request.send(404);
+							return;
+						}
+						auto ResEntry = PortalStaticResMap->get_if([&](StaticResDefaults const &X) {
+							ESPAPP_DEBUGVV("* Matching '%s' with built-in data '%s'...\n",
+								request.url().c_str(), SFPSTR(X.Path));
+							return (request.url() == FPSTR(X.Path));
+						});
+						if (ResEntry) {
+							Portal_WebServer_RespondBuiltInData(request,
+								ResEntry->Content, pathGetEntryName(request.url()));
+						} else request.send(404);
 					});
-					if (ResEntry) {
-						Portal_WebServer_RespondBuiltInData(request,
-							ResEntry->Content, pathGetEntryName(request.url()));
-					} else request.send(404);
-				};
 			}
 
 			AppGlobal.webServer->begin();
@@ -1478,7 +3255,7 @@ static void Portal_TimeAPTest() {
 	unsigned int PortalIdle = GetCurrentTS() - AppGlobal.wsActivityTS;
 	if (PortalIdle >= AppConfig.Portal_APTest) {
 		AppGlobal.wsActivityTS = GetCurrentTS();
-		if (AppConfig.WLAN_AP_Name) {
+		if (AppConfig.WLAN_AP_Name && !AppGlobal.portal.performAPTest) {
 			ESPAPP_DEBUG("Portal idle for %s, testing WiFi access point...\n",
 				ToString(PortalIdle, TimeUnit::SEC, true).c_str());
 			AppGlobal.portal.performAPTest = true;
@@ -1545,6 +3322,8 @@ static void Portal_DNS_SendReply(DNSHeader *header, AsyncUDPPacket &packet) {
 
 static void Portal_Start() {
 	SwitchState(APP_PORTAL);
+	WLANStats.PortalCount++;
+	EventLog_Append(EVENT_PORTAL_START, 0);
 	if (AppConfig.PersistWLAN) {
 		WiFi.persistent(false);
 	}
@@ -1578,58 +3357,179 @@ static void Portal_Start() {
 		panic();
 	}
 
-	AppGlobal.portal.apTestTimer = new Ticker();
-	AppGlobal.portal.apTestTimer->attach(10, Portal_TimeAPTest);
+	AppGlobal.portal.apTestTimer = Wheel_Start(10 * 1000, Portal_TimeAPTest, true);
 
 	AppGlobal.wsSteps = PORTAL_SETUP;
 }
 
+// A stopped portal drains its connections in the background, the holder
+// lives outside of AppGlobal so that it survives state switches
+struct PortalDrainHolder {
+	AsyncWebServer* webServer;
+	HTTPDigestAccountAuthority* webAccounts;
+	SessionAuthority* webAuthSessions;
+	LinkedList<StaticResDefaults>* staticResMap;
+	// Remote endpoints of the connections open at stop time, so that a
+	// portal started meanwhile on the same port keeps its own clients
+	struct {
+		ip_addr_t IP;
+		uint16_t Port;
+	} clients[MEMP_NUM_TCP_PCB];
+	uint8_t clientCount;
+	time_t startTS;
+	bool overdue;
+};
+
+static PortalDrainHolder PortalDrains[PORTAL_DRAIN_SLOTS];
+
+static void Portal_DrainTrack(PortalDrainHolder &Drain) {
+	Drain.clientCount = 0;
+	for (struct tcp_pcb *PCB = tcp_active_pcbs; PCB; PCB = PCB->next) {
+		if (PCB->local_port != PORTAL_HTTP_PORT) continue;
+		if (Drain.clientCount >= MEMP_NUM_TCP_PCB) break;
+		auto &Client = Drain.clients[Drain.clientCount++];
+		ip_addr_copy(Client.IP, PCB->remote_ip);
+		Client.Port = PCB->remote_port;
+	}
+}
+
+static uint8_t Portal_DrainAbort(PortalDrainHolder const &Drain) {
+	uint8_t Count = 0;
+	struct tcp_pcb *PCB = tcp_active_pcbs;
+	while (PCB) {
+		bool Tracked = false;
+		if (PCB->local_port == PORTAL_HTTP_PORT) {
+			for (uint8_t i = 0; i < Drain.clientCount; i++) {
+				auto &Client = Drain.clients[i];
+				if ((Client.Port == PCB->remote_port) &&
+					ip_addr_cmp(&Client.IP, &PCB->remote_ip)) {
+					Tracked = true;
+					break;
+				}
+			}
+		}
+		if (Tracked) {
+			// Aborting unlinks the PCB, restart from the list head
+			tcp_abort(PCB);
+			Count++;
+			PCB = tcp_active_pcbs;
+		} else PCB = PCB->next;
+	}
+	return Count;
+}
+
+static void Portal_DrainRelease(PortalDrainHolder &Drain) {
+	delete Drain.staticResMap;
+	delete Drain.webServer;
+	delete Drain.webAccounts;
+	delete Drain.webAuthSessions;
+	memset(&Drain, 0, sizeof(PortalDrainHolder));
+	ESPAPP_LOG("Device portal has stopped.\n");
+}
+
+static bool Portal_DrainStep(PortalDrainHolder &Drain) {
+	if (!Drain.webServer) return true;
+	if (!Drain.webServer->hasFinished()) {
+		time_t DrainSpan = GetCurrentTS() - Drain.startTS;
+		if (DrainSpan < PORTAL_DRAIN_TIMEOUT) return false;
+		if (!Drain.overdue) {
+			ESPAPP_LOG("WARNING: Aborting %d device portal connections lingering after %s\n",
+				Portal_DrainAbort(Drain), ToString(PORTAL_DRAIN_TIMEOUT, TimeUnit::SEC, true).c_str());
+			Drain.overdue = true;
+			if (!Drain.webServer->hasFinished()) return false;
+		} else {
+			if (DrainSpan < PORTAL_DRAIN_TIMEOUT + PORTAL_DRAIN_GRACE) return false;
+			// Freeing the server under live connections is worse than leaking it
+			ESPAPP_LOG("WARNING: Device portal failed to stop, abandoning its resources\n");
+			memset(&Drain, 0, sizeof(PortalDrainHolder));
+			return true;
+		}
+	}
+	Portal_DrainRelease(Drain);
+	return true;
+}
+
+// Returns true when no stopped portal is left draining
+static bool Portal_Drain() {
+	bool Ret = true;
+	for (uint8_t i = 0; i < PORTAL_DRAIN_SLOTS; i++) {
+		if (!Portal_DrainStep(PortalDrains[i])) Ret = false;
+	}
+	return Ret;
+}
+
+static bool Portal_Draining() {
+	for (uint8_t i = 0; i < PORTAL_DRAIN_SLOTS; i++) {
+		if (PortalDrains[i].webServer) return true;
+	}
+	return false;
+}
+
+// Hand over a drain slot, without waiting for an earlier portal to finish
+static PortalDrainHolder& Portal_DrainSlot() {
+	PortalDrainHolder *Ret = nullptr;
+	for (uint8_t i = 0; i < PORTAL_DRAIN_SLOTS; i++) {
+		auto &Drain = PortalDrains[i];
+		if (!Drain.webServer) return Drain;
+		if (!Ret || ((int32_t)(Drain.startTS - Ret->startTS) < 0)) Ret = &Drain;
+	}
+	// All slots taken by rapid restarts, cut the oldest drain short
+	Portal_DrainAbort(*Ret);
+	if (Ret->webServer->hasFinished()) {
+		Portal_DrainRelease(*Ret);
+	} else {
+		ESPAPP_LOG("WARNING: Device portal failed to stop, abandoning its resources\n");
+		memset(Ret, 0, sizeof(PortalDrainHolder));
+	}
+	return *Ret;
+}
+
 static void Portal_Stop() {
 	if (AppGlobal.webServer) {
 		AppGlobal.webServer->end();
-		while (!AppGlobal.webServer->hasFinished()) {
-			delay(100);
-			if (AppGlobal.State == APP_PORTAL)
-				__userapp_prestart_loop();
-		}
-
-		delete PortalStaticResMap;
+		auto &Drain = Portal_DrainSlot();
+		Portal_DrainTrack(Drain);
+		Drain.webServer = AppGlobal.webServer;
+		Drain.webAccounts = AppGlobal.webAccounts;
+		Drain.webAuthSessions = AppGlobal.webAuthSessions;
+		Drain.staticResMap = PortalStaticResMap;
+		Drain.startTS = GetCurrentTS();
 		PortalStaticResMap = nullptr;
-		delete AppGlobal.webServer;
 		AppGlobal.webServer = nullptr;
-		delete AppGlobal.webAccounts;
 		AppGlobal.webAccounts = nullptr;
-		delete AppGlobal.webAuthSessions;
 		AppGlobal.webAuthSessions = nullptr;
-		ESPAPP_LOG("Device portal has stopped.\n");
 		AppGlobal.wsSteps = PORTAL_OFF;
+		EventLog_Append(EVENT_PORTAL_STOP, 0);
+		ESPAPP_DEBUG("Device portal stopping...\n");
+		Portal_DrainStep(Drain);
 	}
 }
 
-static void Portal_APTest() {
+static void Portal_APTest_Start() {
 	ESPAPP_DEBUG("Probing WiFi access point '%s'...\n", AppConfig.WLAN_AP_Name.c_str());
-	WiFi.begin(AppConfig.WLAN_AP_Name.c_str(), AppConfig.WLAN_AP_Pass.c_str());
-	bool Connected = false;
-	time_t startTS = GetCurrentTS();
-	do {
-		// Fast exit if AP scan is in progress
-		if (APScanInProgress) {
-			WiFi.disconnect(false);
-			return;
-		}
+	// Base station stays up, portal clients are served while probing
+	WiFi.begin(AppConfig.WLAN_AP_Name.c_str(), wlan_passphrase());
+	AppGlobal.portal.apTestTS = GetCurrentTS();
+}
 
-		delay(100);
-		// We are taking a long time off the main loop, need to invoke user app loop separately
-		__userapp_prestart_loop();
-		if (APConnected) {
-			ESPAPP_LOG("Successfully connected to WiFi access point '%s'!\n",
-				AppConfig.WLAN_AP_Name.c_str());
-			Connected = true;
-			startTS = 0;
-		}
-	} while (GetCurrentTS() - startTS < AppConfig.Init_Retry_Cycle);
+static void Portal_APTest_Finish() {
+	AppGlobal.portal.performAPTest = false;
+	AppGlobal.portal.apScanRequest = false;
+	AppGlobal.portal.apTestTS = 0;
+}
 
-	if (Connected) {
+static void Portal_APTest_Step() {
+	// Fast exit if AP scan has been requested
+	if (AppGlobal.portal.apScanRequest) {
+		WiFi.disconnect(false);
+		Portal_APTest_Finish();
+		return;
+	}
+
+	if (APConnected) {
+		ESPAPP_LOG("Successfully connected to WiFi access point '%s'!\n",
+			AppConfig.WLAN_AP_Name.c_str());
+		Portal_APTest_Finish();
 		// Turn off AP
 		if (!WiFi.enableAP(false)) {
 			ESPAPP_LOG("ERROR: Failed to disable WiFi base station mode!\n");
@@ -1638,19 +3538,29 @@ static void Portal_APTest() {
 		ESPAPP_LOG("WiFi base station '%s' disabled!\n", AppConfig.Hostname.c_str());
 		// Retry init stage again
 		Init_Start();
-	} else {
+		return;
+	}
+
+	if (GetCurrentTS() - AppGlobal.portal.apTestTS >= AppConfig.Init_Retry_Cycle) {
 		// Turn off STA
+		WLANStats_Leave();
 		WiFi.disconnect(true);
 		ESPAPP_DEBUG("Unable to connect to WiFi access point '%s'\n",
 			AppConfig.WLAN_AP_Name.c_str());
+		Portal_APTest_Finish();
 	}
 }
 
 static void loop_PORTAL() {
 	Portal_WebServer_Operations();
 	if (AppGlobal.portal.performAPTest) {
-		Portal_APTest();
-		AppGlobal.portal.performAPTest = false;
+		if (!AppGlobal.portal.apTestTS) {
+			// Do not interfere with an on-going or requested AP scan,
+			// the scan owns its progress flag and clears it when done
+			if (!APScanInProgress && !AppGlobal.portal.apScanRequest) {
+				Portal_APTest_Start();
+			} else Portal_APTest_Finish();
+		} else Portal_APTest_Step();
 	}
 }
 
@@ -1660,10 +3570,14 @@ static void perform_DevReset() {
 		ESPAPP_DEBUG("ERROR: Failed to format file system!\n");
 		panic();
 	}
+	ConfigCache_Clear();
 	SwitchState(APP_DEVRESTART);
 }
 
 static void perform_DevRestart() {
+	if (!ConfigCache_FlushAll()) {
+		ESPAPP_LOG("WARNING: Failed to write back one or more configurations\n");
+	}
 	ESPAPP_DEBUG("Unmounting file system...\n");
 	VFATFS.end();
 	ESPAPP_DEBUG("Saving clock to RTC...\n");
@@ -1677,7 +3591,8 @@ static void perform_DevRestart() {
 static void Service_TimePortal() {
 	unsigned int PortalIdle = GetCurrentTS() - AppGlobal.wsActivityTS;
 	if (PortalIdle >= AppConfig.Portal_Timeout) {
-		AppGlobal.service.portalTimer->detach();
+		Wheel_Stop(AppGlobal.service.portalTimer);
+		AppGlobal.service.portalTimer = WHEEL_TIMER_NONE;
 		if (!AppGlobal.NoService) {
 			ESPAPP_DEBUG("Portal idle for %s, shutting down...\n",
 				ToString(PortalIdle, TimeUnit::SEC, true).c_str());
@@ -1688,9 +3603,8 @@ static void Service_TimePortal() {
 
 static void Service_StartPortal(time_t StartTS) {
 	if (AppConfig.Portal_Timeout) {
-		if (!AppGlobal.service.portalTimer)
-			AppGlobal.service.portalTimer = new Ticker();
-		AppGlobal.service.portalTimer->attach(10, Service_TimePortal);
+		Wheel_Stop(AppGlobal.service.portalTimer);
+		AppGlobal.service.portalTimer = Wheel_Start(10 * 1000, Service_TimePortal, true);
 	}
 	AppGlobal.wsActivityTS = StartTS;
 	AppGlobal.wsSteps = PORTAL_SETUP;
@@ -1740,8 +3654,7 @@ static void Service_APMonitor() {
 static void Service_Start() {
 	SwitchState(APP_SERVICE);
 
-	AppGlobal.service.apTestTimer = new Ticker();
-	AppGlobal.service.apTestTimer->attach(1, Service_APMonitor);
+	AppGlobal.service.apTestTimer = Wheel_Start(1000, Service_APMonitor, true);
 	if (AppConfig.Portal_Timeout || AppGlobal.NoService) {
 		Service_StartPortal(AppGlobal.StageTS);
 	}
@@ -1755,6 +3668,88 @@ static void Service_Start() {
 	}
 }
 
+static void Service_ClearTasks() {
+	for (int8_t i = 0; i < SERVICE_TASK_SLOTS; i++) {
+		// Keep name and statistics for inspection
+		if (ServiceTasks[i].Type != TASK_FREE) {
+			ServiceTasks[i].Type = TASK_FREE;
+			// Let a running task notice that it was cancelled
+			ServiceTasks[i].Seq++;
+		}
+		if (i != ServiceTaskRunning) ServiceTasks[i].Callback = nullptr;
+	}
+	Wheel_StopUser();
+}
+
+static void Service_RunTasks() {
+	uint32_t curMS = millis();
+	time_t curTS = 0;
+	for (int8_t i = 0; i < SERVICE_TASK_SLOTS; i++) {
+		auto &Task = ServiceTasks[i];
+		switch (Task.Type) {
+			case TASK_FREE: continue;
+			case TASK_DEADLINE: {
+				if (!curTS) curTS = GetCurrentTS();
+				if (curTS < Task.DueTS) continue;
+			} break;
+			default: {
+				if ((int32_t)(curMS - Task.DueMS) < 0) continue;
+			}
+		}
+
+		uint16_t Seq = Task.Seq;
+		ServiceTaskRunning = i;
+		uint32_t StartUS = micros();
+		Task.Callback();
+		uint32_t SpanUS = micros() - StartUS;
+		ServiceTaskRunning = APPLIANCE_TASK_NONE;
+		// Task may have been cancelled or replaced during the run
+		if (Task.Seq != Seq) {
+			if (Task.Type == TASK_FREE) Task.Callback = nullptr;
+			continue;
+		}
+		Task.Runtime.record(SpanUS);
+
+		if (Task.Type == TASK_PERIODIC) {
+			Task.DueMS += Task.PeriodMS;
+			// Do not try to catch up with missed periods
+			uint32_t nowMS = millis();
+			if ((int32_t)(nowMS - Task.DueMS) >= 0)
+				Task.DueMS = nowMS + Task.PeriodMS;
+		} else if (Task.Type != TASK_FREE) {
+			Task.Type = TASK_FREE;
+			Task.Callback = nullptr;
+		}
+	}
+}
+
+// Milliseconds until the next scheduled task is due, capped to LOOP_IDLE_MAXIMUM;
+// timers, jobs and schedule changes wake up the loop by themselves
+static uint32_t Service_IdleSpan() {
+	uint32_t Ret = LOOP_IDLE_MAXIMUM;
+	uint32_t curMS = millis();
+	time_t curTS = 0;
+	for (int8_t i = 0; i < SERVICE_TASK_SLOTS; i++) {
+		auto &Task = ServiceTasks[i];
+		int32_t Due;
+		switch (Task.Type) {
+			case TASK_FREE: continue;
+			case TASK_DEADLINE: {
+				if (!curTS) curTS = GetCurrentTS();
+				if (Task.DueTS <= curTS) return 0;
+				Due = (Task.DueTS - curTS) > (LOOP_IDLE_MAXIMUM / 1000)?
+					LOOP_IDLE_MAXIMUM : (Task.DueTS - curTS) * 1000;
+			} break;
+			default: {
+				Due = (int32_t)(Task.DueMS - curMS);
+			}
+		}
+		if (Due <= 0) return 0;
+		if ((uint32_t)Due < Ret) Ret = Due;
+	}
+	return Ret;
+}
+
 static void loop_SERVICE() {
 	if (AppGlobal.service.portalFallback) {
 		// Pause mode switching if AP scan is in progress
@@ -1764,9 +3759,13 @@ static void loop_SERVICE() {
 			WiFi.persistent(false);
 		}
 		// Turn off STA
+		WLANStats_Leave();
 		WiFi.disconnect(true);
 		// Forget that we had an IP
 		APReceivedIP = false;
+		// The cached lease is likely stale after a long outage
+		clear_wlan_lease();
+		WiFi.config(IPAddress(), IPAddress(), IPAddress());
 		delay(100);
 		Portal_Start();
 		return;
@@ -1776,13 +3775,20 @@ static void loop_SERVICE() {
 		if (AppGlobal.service.reload) {
 			AppGlobal.service.reload = false;
 			__userapp_teardown();
+			Service_ClearTasks();
+			ConfigCache_FlushAll();
 			if (!__userapp_startup()) {
 				// Fall back to service bypass mode
 				AppGlobal.NoService = true;
 				return;
 			}
 		}
+		Service_RunTasks();
+		// A task may have ended the service (e.g. device restart)
+		if (AppGlobal.State != APP_SERVICE) return;
+		uint32_t UserUS = micros();
 		__userapp_loop();
+		LoopStats.User[APP_SERVICE].record(micros() - UserUS);
 	} else {
 		if (AppGlobal.wsSteps == PORTAL_OFF) {
 			AppGlobal.wsSteps = PORTAL_SETUP;
@@ -1793,6 +3799,19 @@ static void loop_SERVICE() {
 }
 
 void loop() {
+	{
+		uint32_t StartUS = micros();
+		if (LoopStats.Started && AppGlobal.State < LOOP_STATS_STATES) {
+			LoopStats.Gap[AppGlobal.State].record(StartUS - LoopStats.LastUS - LoopStats.IdleUS);
+			LoopStats.IdleTotalUS[AppGlobal.State] += LoopStats.IdleUS;
+		}
+		LoopStats.Started = true;
+		LoopStats.LastUS = StartUS;
+		LoopStats.IdleUS = 0;
+	}
+	Work_Drain();
+	if (TimerWheel.Missed) Wheel_Dispatch();
+
 	switch (AppGlobal.State) {
 		case APP_STARTUP:
 			if (!AppConfig.WLAN_AP_Name.empty()) {
@@ -1828,8 +3847,24 @@ void loop() {
 			panic();
 	}
 	if (AppGlobal.State < APP_SERVICE) {
+		AppState State = AppGlobal.State;
+		uint32_t UserUS = micros();
 		__userapp_prestart_loop();
+		LoopStats.User[State].record(micros() - UserUS);
 	}
+	if (FSStats.Refresh) FS_UpdateStats();
+	else if ((AppGlobal.State == APP_PORTAL) && (AppGlobal.wsSteps == PORTAL_UP)) {
+		// Portal is served asynchronously, nothing to do until next event
+		Loop_Idle(Portal_Draining()? LOOP_IDLE_POLL : LOOP_IDLE_MAXIMUM);
+	} else if ((AppGlobal.State == APP_SERVICE) && !AppGlobal.service.reload &&
+		!AppGlobal.service.portalFallback &&
+		((AppGlobal.wsSteps == PORTAL_OFF) || (AppGlobal.wsSteps == PORTAL_UP))) {
+		// Sleep until the next task is due, or an event arrives
+		uint32_t IdleMS = Service_IdleSpan();
+		if (Portal_Draining() && (IdleMS > LOOP_IDLE_POLL)) IdleMS = LOOP_IDLE_POLL;
+		if (IdleMS) Loop_Idle(IdleMS);
+	}
+	if (Portal_Draining()) Portal_Drain();
 }
 
 // User-App service routines
@@ -1859,12 +3894,34 @@ time_t Appliance_LocalTimeofDay(struct tm *tm_out, TimeChangeRule **tcr) {
 
 JsonManagerResults Appliance_LoadConfig(String const &filename,
 	std::function<void(JsonObject const &obj)> const &callback) {
-	return load_config(filename, callback);
+	JsonManagerResults Ret;
+	auto Entry = ConfigCache_Load(filename, Ret);
+	if (!Entry) return Ret;
+	return ConfigCache_Apply(*Entry, [&](JsonObject &obj, BoundedDynamicJsonBuffer &buf) {
+		callback(obj);
+		return false;
+	}, false);
 }
 
 JsonManagerResults Appliance_UpdateConfig(String const &filename,
-	JsonObjectCallback const &callback) {
-	return update_config(filename, callback);
+	JsonObjectCallback const &callback, bool deferred) {
+	JsonManagerResults Ret;
+	auto Entry = ConfigCache_Load(filename, Ret);
+	if (!Entry) return Ret;
+	return ConfigCache_Apply(*Entry, callback, deferred);
+}
+
+bool Appliance_FlushConfig() {
+	return ConfigCache_FlushAll();
+}
+
+JsonManagerResults Appliance_StreamConfig(String const &filename,
+	JsonMemberCallback const &callback, JsonAppendCallback const &append) {
+	ConfigCache_Sync(filename, false);
+	auto ConfigDir = get_dir(FL(CONFIG_DIR));
+	auto Ret = JsonStreamManager(ConfigDir, filename, true, callback, append);
+	if (Ret == JSONMAN_OK_UPDATED) ConfigCache_Sync(filename, true);
+	return Ret;
 }
 
 bool Appliance_RTCMemory_isRestored() {
@@ -1872,7 +3929,13 @@ bool Appliance_RTCMemory_isRestored() {
 }
 
 uint8_t Appliance_RTCMemory_Available() {
-	return RTCMEMORY_USERSLOTS - RTC_SLOTS_RESERVED;
+	return APPLIANCE_RTCMEMORY_USERSLOTS;
+}
+
+bool Appliance_RTCMemory_Attach(RTCRegion const *regions, uint8_t count) {
+	RTCMemory &RTCMem = RTCMemory::Manager();
+	return RTCMem.Attach(RTC_SLOTS_RESERVED, APPLIANCE_RTCMEMORY_USERSLOTS,
+		regions, count);
 }
 
 bool Appliance_RTCMemory_Read(uint8_t offset, uint32_t *buf, uint8_t count) {
@@ -1885,6 +3948,18 @@ bool Appliance_RTCMemory_Write(uint8_t offset, uint32_t *buf, uint8_t count) {
 	return RTCMem.Write(RTC_SLOTS_RESERVED+offset, buf, count);
 }
 
+void Appliance_EventLog(uint8_t code, uint8_t arg) {
+	EventLog_Append((EventType)(EVENT_USER | (code & APPLIANCE_EVENT_CODE_MAX)), arg);
+}
+
+void Appliance_RTCMemory_Begin() {
+	RTCMemory::Manager().Begin();
+}
+
+bool Appliance_RTCMemory_Commit() {
+	return RTCMemory::Manager().Commit();
+}
+
 AsyncWebServer* Appliance_WebPortal() {
 	return AppGlobal.webServer;
 }
@@ -1902,6 +3977,11 @@ void Appliance_WebPortal_Stop() {
 }
 
 void Appliance_WebPortal_RegisterStaticResDefault(PGM_P path, PGM_P content) {
+	if (!PortalStaticResMap) {
+		ESPAPP_DEBUG("WARNING: Portal not running, ignored built-in data '%s'\n",
+			SFPSTR(path));
+		return;
+	}
 	PortalStaticResMap->append({path, content});
 }
 
@@ -1922,12 +4002,86 @@ File Appliance_WebPortal_CheckRestoreRes(Dir &dir, String const &resfile,
 
 void Appliance_Service_Reload() {
 	AppGlobal.service.reload = true;
+	Loop_Wakeup();
 }
 
 void Appliance_Device_Restart() {
 	SwitchState(APP_DEVRESTART);
 }
 
+static int8_t Service_ScheduleTask(TaskType type, String const &name,
+	TaskCallback const &callback) {
+	if (!callback) return APPLIANCE_TASK_NONE;
+	for (int8_t i = 0; i < SERVICE_TASK_SLOTS; i++) {
+		auto &Task = ServiceTasks[i];
+		// Do not overwrite the callback that is currently running
+		if (Task.Type != TASK_FREE || i == ServiceTaskRunning) continue;
+		Task.Type = type;
+		Task.Seq++;
+		Task.Name = name;
+		Task.Callback = callback;
+		memset(&Task.Runtime, 0, sizeof(LatencyStats));
+		// Re-evaluate the idle span of the main loop
+		Loop_Wakeup();
+		return i;
+	}
+	ESPAPP_DEBUG("WARNING: No task slot available for '%s'\n", name.c_str());
+	return APPLIANCE_TASK_NONE;
+}
+
+int8_t Appliance_Schedule_Periodic(String const &name, uint32_t period_ms,
+	TaskCallback const &callback) {
+	int8_t Ret = Service_ScheduleTask(TASK_PERIODIC, name, callback);
+	if (Ret != APPLIANCE_TASK_NONE) {
+		ServiceTasks[Ret].PeriodMS = period_ms;
+		ServiceTasks[Ret].DueMS = millis() + period_ms;
+	}
+	return Ret;
+}
+
+int8_t Appliance_Schedule_Once(String const &name, uint32_t delay_ms,
+	TaskCallback const &callback) {
+	int8_t Ret = Service_ScheduleTask(TASK_ONCE, name, callback);
+	if (Ret != APPLIANCE_TASK_NONE) {
+		ServiceTasks[Ret].PeriodMS = 0;
+		ServiceTasks[Ret].DueMS = millis() + delay_ms;
+	}
+	return Ret;
+}
+
+int8_t Appliance_Schedule_Deadline(String const &name, time_t deadline,
+	TaskCallback const &callback) {
+	int8_t Ret = Service_ScheduleTask(TASK_DEADLINE, name, callback);
+	if (Ret != APPLIANCE_TASK_NONE) {
+		ServiceTasks[Ret].PeriodMS = 0;
+		ServiceTasks[Ret].DueTS = deadline;
+	}
+	return Ret;
+}
+
+uint8_t Appliance_Timer_Start(uint32_t interval_ms, TaskCallback const &callback,
+	bool repeat) {
+	uint8_t Ret = Wheel_Start(interval_ms, callback, repeat);
+	if (Ret != WHEEL_TIMER_NONE) TimerWheel.Timers[Ret - 1].User = true;
+	return Ret;
+}
+
+void Appliance_Timer_Stop(uint8_t timer) {
+	if (timer == WHEEL_TIMER_NONE || timer > WHEEL_TIMERS) return;
+	// Core timers are not for the user-app to stop
+	if (TimerWheel.Timers[timer - 1].User) Wheel_Stop(timer);
+}
+
+bool Appliance_Schedule_Cancel(int8_t task) {
+	if (task < 0 || task >= SERVICE_TASK_SLOTS) return false;
+	auto &Task = ServiceTasks[task];
+	if (Task.Type == TASK_FREE) return false;
+	Task.Type = TASK_FREE;
+	Task.Seq++;
+	if (task != ServiceTaskRunning) Task.Callback = nullptr;
+	return true;
+}
+
 static void APScan_Finished(bss_info* result, STATUS status) {
 	Portal_StopAPScan();
 	if (status != OK) {
@@ -2005,6 +4159,7 @@ bool Appliance_APScan_Start(wifi_scan_type_t ScanType, time_t FreshDur) {
 	}
 	if (!WiFi.enableSTA(true)) {
 		ESPAPP_DEBUG("Failed to enable WiFi client mode for AP scan\n");
+		Portal_StopAPScan();
 		return false;
 	}
 	scan_config config = {0};
@@ -2012,6 +4167,7 @@ bool Appliance_APScan_Start(wifi_scan_type_t ScanType, time_t FreshDur) {
 	config.scan_type = ScanType;
 	if (!wifi_station_scan(&config, (scan_done_cb_t)APScan_Finished)) {
 		ESPAPP_DEBUG("Failed to start AP scan\n");
+		Portal_StopAPScan();
 		return false;
 	}
 	return true;
@@ -4,6 +4,10 @@
 #define ZWAPP_VERSION   "0.3"
 
 #define PORTAL_SHUTDOWN_DELAY   1
+#define PORTAL_HTTP_PORT        80
+#define PORTAL_DRAIN_TIMEOUT    30    // Seconds before lingering portal connections are aborted
+#define PORTAL_DRAIN_GRACE      2     // Seconds to wait for aborted connections before abandoning them
+#define PORTAL_DRAIN_SLOTS      2     // Stopped portals that may be draining at the same time
 #define TRIVIAL_FAILURE_DELAY   300   // Seconds within which a service failure is considered "trivial"
 
 #define WIFI_POWER_MAX          20.5
@@ -28,6 +32,7 @@
 
 #define CONFIG_DIR              "/config"
 #define APPLIANCE_CONFIG_FILE   "appliance.json"
+#define CONFIG_BACKUP_EXT       ".bak"
 #define PORTAL_ACCOUNTS_FILE    "portal.accounts.txt"
 #define PORTAL_ACCESS_FILE      "portal.access.txt"
 
@@ -58,10 +63,20 @@
 #define PORTAL_API_HWCTL_DEVRESET     PORTAL_API_HWCTL "reset"
 #define PORTAL_API_HWCTL_DEVRESTART   PORTAL_API_HWCTL "restart"
 #define PORTAL_API_HWCTL_APSCAN       PORTAL_API_HWCTL "apscan"
+#define PORTAL_API_HWCTL_LOOPRESET    PORTAL_API_HWCTL "loopreset"
 
 #define PORTAL_API_HWMON          PORTAL_API_ROOT  "hwmon/"
 #define PORTAL_API_HWMON_HEAP     PORTAL_API_HWMON "heap"
 #define PORTAL_API_HWMON_UPTIME   PORTAL_API_HWMON "uptime"
+#define PORTAL_API_HWMON_STAGES   PORTAL_API_HWMON "stages"
+#define PORTAL_API_HWMON_WLAN     PORTAL_API_HWMON "wlan"
+#define PORTAL_API_HWMON_PORTAL   PORTAL_API_HWMON "portal"
+#define PORTAL_API_HWMON_BOOTTRACE  PORTAL_API_HWMON "boottrace"
+#define PORTAL_API_HWMON_FS       PORTAL_API_HWMON "fs"
+#define PORTAL_API_HWMON_TASKS    PORTAL_API_HWMON "tasks"
+#define PORTAL_API_HWMON_LOOP     PORTAL_API_HWMON "loop"
+#define PORTAL_API_HWMON_EVENTS   PORTAL_API_HWMON "events"
+#define PORTAL_API_HWMON_CONFIG   PORTAL_API_HWMON "config"
 
 #define PORTAL_API_VERSION        PORTAL_API_ROOT "version/"
 #define PORTAL_API_VERSION_ZWAPP  PORTAL_API_VERSION "zwapp"
@@ -109,6 +124,8 @@ const char CONFIGKEY_PowerSaving[] PROGMEM = "PowerSaving";
 const char CONFIGKEY_WiFi_Power[] PROGMEM = "WiFi_Power";
 const char CONFIGKEY_WLAN_AP_Name[] PROGMEM = "WLAN_AP_Name";
 const char CONFIGKEY_WLAN_AP_Pass[] PROGMEM = "WLAN_AP_Pass";
+const char CONFIGKEY_WLAN_AP_PMK[] PROGMEM = "WLAN_AP_PMK";
+const char CONFIGKEY_WLAN_AP_PMK_Tag[] PROGMEM = "WLAN_AP_PMK_Tag";
 const char CONFIGKEY_WLAN_WPS[] PROGMEM = "WLAN_WPS";
 const char CONFIGKEY_Init_Retry_Count[] PROGMEM = "Init_Retry_Count";
 const char CONFIGKEY_Init_Retry_Cycle[] PROGMEM = "Init_Retry_Cycle";